@@ -47,12 +47,39 @@
 ***************************************************************************/
 #include <stdlib.h>
 #include <errno.h>
+#include <stdint.h>
 #include "bitfile.h"
 
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/** The number of bits in the bit buffer */
+#define BF_WORD_BITS    64
+
+/** The number of bytes in the bit buffer */
+#define BF_WORD_BYTES   (BF_WORD_BITS / 8)
+
+/** The alignment of the I/O buffer in bytes */
+#define BF_BUFFER_ALIGN 64
+
+/***************************************************************************
+*                                 MACROS
+***************************************************************************/
+/** A bf_word_t with the \c n least significant bits set (0 <= n <= 64) */
+#define BF_MASK(n)  (((n) >= BF_WORD_BITS) ? ~(bf_word_t)0 : \
+    (((bf_word_t)1 << (n)) - 1))
+
 /***************************************************************************
 *                            TYPE DEFINITIONS
 ***************************************************************************/
 
+/**
+ * \typedef bf_word_t
+ * \brief This is the type of the bit buffer.  Bits are read from and written
+ * to files a whole word at a time, most significant byte first.
+ */
+typedef uint64_t bf_word_t;
+
 /**
  * \typedef num_func_t
  * \brief This type to points to the kind of functions that put/get bits
@@ -71,8 +98,14 @@ typedef int (*num_func_t)(bit_file_t*, void*, const unsigned int, const size_t);
 struct bit_file_t
 {
     FILE *fp;                   /*!< file pointer used by stdio functions */
-    unsigned char bitBuffer;    /*!< bits waiting to be read/written */
-    unsigned char bitCount;     /*!< number of bits in bitBuffer */
+    bf_word_t bitBuffer;        /*!< bits waiting to be read/written, right
+                                    justified */
+    unsigned int bitCount;      /*!< number of bits in bitBuffer */
+    unsigned char *buffer;      /*!< aligned I/O buffer */
+    void *allocation;           /*!< memory block containing buffer */
+    size_t bufferSize;          /*!< size of the I/O buffer in bytes */
+    size_t bufferIndex;         /*!< next byte to read/write in buffer */
+    size_t bufferEnd;           /*!< end of valid bytes in a read buffer */
     num_func_t PutBitsNumFunc;  /*!< endian specific BitFilePutBitsNum */
     num_func_t GetBitsNumFunc;  /*!< endian specific BitFileGetBitsNum */
     BF_MODES mode;              /*!< open for read, write, or append */
@@ -106,6 +139,16 @@ typedef union
 ***************************************************************************/
 static endian_t DetermineEndianess(void);
 
+static int BitFileFillBuffer(bit_file_t *stream);
+static int BitFileFlushBuffer(bit_file_t *stream);
+static int BitFileReadWord(bit_file_t *stream);
+static int BitFileWriteWord(bit_file_t *stream);
+static int BitFileWritePending(bit_file_t *stream, const unsigned char fill);
+static int BitFileGetWord(bit_file_t *stream, bf_word_t *value,
+    const unsigned int count);
+static int BitFilePutWord(bit_file_t *stream, const bf_word_t value,
+    const unsigned int count);
+
 static int BitFilePutBitsLE(bit_file_t *stream, void *bits,
     const unsigned int count, const size_t size);
 static int BitFilePutBitsBE(bit_file_t *stream, void *bits,
@@ -142,65 +185,66 @@ static int BitFileNotSupported(bit_file_t *stream, void *bits,
  *
  * This function opens a bit file for reading, writing, or appending.  If
  * successful, a bit_file_t data structure will be allocated and a pointer
- * to the structure will be returned.
+ * to the structure will be returned.  The bit file uses an I/O buffer of
+ * \c BF_DEFAULT_BUFFER_SIZE bytes.
  */
- bit_file_t *BitFileOpen(const char *fileName, const BF_MODES mode)
+bit_file_t *BitFileOpen(const char *fileName, const BF_MODES mode)
+{
+    return BitFileOpenBuffered(fileName, mode, BF_DEFAULT_BUFFER_SIZE);
+}
+
+/**
+ * \fn bit_file_t *BitFileOpenBuffered(const char *fileName,
+ * const BF_MODES mode, const size_t bufferSize)
+ *
+ * \brief This function opens a bit file for reading, writing, or appending
+ * using an I/O buffer of the requested size.
+ *
+ * \param fileName A pointer to a \c NULL terminated string containing the
+ * name of the file to be opened.
+ *
+ * \param mode The mode of the file to be opened (BF_READ, BF_WRITE, or
+ * BF_APPEND).
+ *
+ * \param bufferSize The size of the I/O buffer in bytes.  Sizes smaller
+ * than 8 bytes are rounded up to 8 bytes.
+ *
+ * \effects
+ * The specified file will be opened and file structure and I/O buffer
+ * will be allocated.
+ *
+ * \returns A pointer to the bit_file_t structure for the bit file opened,
+ * or \c NULL on failure.  \c errno will be set for all failure cases.
+ */
+bit_file_t *BitFileOpenBuffered(const char *fileName, const BF_MODES mode,
+    const size_t bufferSize)
 {
     const char modes[3][3] = {"rb", "wb", "ab"};    /* binary modes for fopen */
+    FILE *fp;
     bit_file_t *bf;
 
-    bf = (bit_file_t *)malloc(sizeof(bit_file_t));
+    fp = fopen(fileName, modes[mode]);
 
-    if (bf == NULL)
+    if (fp == NULL)
     {
-        /* malloc failed */
-        errno = ENOMEM;
+        /* fopen failed */
+        return NULL;
     }
-    else
-    {
-        bf->fp = fopen(fileName, modes[mode]);
 
-        if (bf->fp == NULL)
-        {
-            /* fopen failed */
-            free(bf);
-            bf = NULL;
-        }
-        else
-        {
-            /* fopen succeeded fill in remaining bf data */
-            bf->bitBuffer = 0;
-            bf->bitCount = 0;
-            bf->mode = mode;
-
-            switch (DetermineEndianess())
-            {
-                case BF_LITTLE_ENDIAN:
-                    bf->PutBitsNumFunc = &BitFilePutBitsLE;
-                    bf->GetBitsNumFunc = &BitFileGetBitsLE;
-                    break;
-
-                case BF_BIG_ENDIAN:
-                    bf->PutBitsNumFunc = &BitFilePutBitsBE;
-                    bf->GetBitsNumFunc = &BitFileGetBitsBE;
-                    break;
-
-                case BF_UNKNOWN_ENDIAN:
-                default:
-                    bf->PutBitsNumFunc = BitFileNotSupported;
-                    bf->GetBitsNumFunc = BitFileNotSupported;
-                    break;
-            }
+    bf = MakeBitFileBuffered(fp, mode, bufferSize);
 
-            /***************************************************************
-            * TO DO: Consider using the last byte in a file to indicate
-            * the number of bits in the previous byte that actually have
-            * data.  If I do that, I'll need special handling of files
-            * opened with a mode of BF_APPEND.
-            ***************************************************************/
-        }
+    if (bf == NULL)
+    {
+        fclose(fp);
+        errno = ENOMEM;
     }
 
+    /***********************************************************************
+    * TO DO: Consider using the last byte in a file to indicate the number
+    * of bits in the previous byte that actually have data.  If I do that,
+    * I'll need special handling of files opened with a mode of BF_APPEND.
+    ***********************************************************************/
+
     return (bf);
 }
 
@@ -224,54 +268,107 @@ static int BitFileNotSupported(bit_file_t *stream, void *bits,
  *
  * This function naively wraps a standard file in a bit_file_t structure.
  * ANSI-C doesn't support file status functions commonly found in other C
- * variants, so the caller must be passed as a parameter.
+ * variants, so the caller must be passed as a parameter.  The bit file uses
+ * an I/O buffer of \c BF_DEFAULT_BUFFER_SIZE bytes.
  */
 bit_file_t *MakeBitFile(FILE *stream, const BF_MODES mode)
+{
+    return MakeBitFileBuffered(stream, mode, BF_DEFAULT_BUFFER_SIZE);
+}
+
+/**
+ * \fn bit_file_t *MakeBitFileBuffered(FILE *stream, const BF_MODES mode,
+ * const size_t bufferSize)
+ *
+ * \brief This function naively wraps a standard file in a bit_file_t
+ * structure using an I/O buffer of the requested size.
+ *
+ * \param stream A pointer to the standard file being wrapped.
+ *
+ * \param mode The mode of the file being wrapped (BF_READ, BF_WRITE, or
+ * BF_APPEND).
+ *
+ * \param bufferSize The size of the I/O buffer in bytes.  Sizes smaller
+ * than 8 bytes are rounded up to 8 bytes.
+ *
+ * \effects
+ * A bit_file_t structure and I/O buffer will be created for the stream
+ * passed as a parameter.
+ *
+ * \returns Pointer to the bit_file_t structure for the bit file or \c NULL
+ * on failure.  \c errno will be set for all failure cases.
+ *
+ * The I/O buffer is aligned to a \c BF_BUFFER_ALIGN byte boundary.  It is
+ * filled with \c fread and emptied with \c fwrite, so the stream isn't
+ * accessed a byte at a time.
+ */
+bit_file_t *MakeBitFileBuffered(FILE *stream, const BF_MODES mode,
+    const size_t bufferSize)
 {
     bit_file_t *bf;
+    size_t misalignment;
 
     if (stream == NULL)
     {
         /* can't wrapper empty steam */
         errno = EBADF;
-        bf = NULL;
+        return NULL;
     }
-    else
+
+    bf = (bit_file_t *)malloc(sizeof(bit_file_t));
+
+    if (bf == NULL)
     {
-        bf = (bit_file_t *)malloc(sizeof(bit_file_t));
+        /* malloc failed */
+        errno = ENOMEM;
+        return NULL;
+    }
 
-        if (bf == NULL)
-        {
-            /* malloc failed */
-            errno = ENOMEM;
-        }
-        else
-        {
-            /* set structure data */
-            bf->fp = stream;
-            bf->bitBuffer = 0;
-            bf->bitCount = 0;
-            bf->mode = mode;
+    bf->bufferSize = (bufferSize < BF_WORD_BYTES) ? BF_WORD_BYTES : bufferSize;
+    bf->allocation = malloc(bf->bufferSize + BF_BUFFER_ALIGN - 1);
 
-            switch (DetermineEndianess())
-            {
-                case BF_LITTLE_ENDIAN:
-                    bf->PutBitsNumFunc = &BitFilePutBitsLE;
-                    bf->GetBitsNumFunc = &BitFileGetBitsLE;
-                    break;
-
-                case BF_BIG_ENDIAN:
-                    bf->PutBitsNumFunc = &BitFilePutBitsBE;
-                    bf->GetBitsNumFunc = &BitFileGetBitsBE;
-                    break;
-
-                case BF_UNKNOWN_ENDIAN:
-                default:
-                    bf->PutBitsNumFunc = BitFileNotSupported;
-                    bf->GetBitsNumFunc = BitFileNotSupported;
-                    break;
-            }
-        }
+    if (bf->allocation == NULL)
+    {
+        /* malloc failed */
+        free(bf);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    /* round the buffer up to an aligned address */
+    misalignment = (size_t)bf->allocation % BF_BUFFER_ALIGN;
+    bf->buffer = (unsigned char *)bf->allocation;
+
+    if (misalignment != 0)
+    {
+        bf->buffer += BF_BUFFER_ALIGN - misalignment;
+    }
+
+    /* set structure data */
+    bf->fp = stream;
+    bf->bitBuffer = 0;
+    bf->bitCount = 0;
+    bf->bufferIndex = 0;
+    bf->bufferEnd = 0;
+    bf->mode = mode;
+
+    switch (DetermineEndianess())
+    {
+        case BF_LITTLE_ENDIAN:
+            bf->PutBitsNumFunc = &BitFilePutBitsLE;
+            bf->GetBitsNumFunc = &BitFileGetBitsLE;
+            break;
+
+        case BF_BIG_ENDIAN:
+            bf->PutBitsNumFunc = &BitFilePutBitsBE;
+            bf->GetBitsNumFunc = &BitFileGetBitsBE;
+            break;
+
+        case BF_UNKNOWN_ENDIAN:
+        default:
+            bf->PutBitsNumFunc = BitFileNotSupported;
+            bf->GetBitsNumFunc = BitFileNotSupported;
+            break;
     }
 
     return (bf);
@@ -345,11 +442,8 @@ int BitFileClose(bit_file_t *stream)
     if ((stream->mode == BF_WRITE) || (stream->mode == BF_APPEND))
     {
         /* write out any unwritten bits */
-        if (stream->bitCount != 0)
-        {
-            (stream->bitBuffer) <<= 8 - (stream->bitCount);
-            fputc(stream->bitBuffer, stream->fp);   /* handle error? */
-        }
+        BitFileWritePending(stream, 0);     /* handle error? */
+        BitFileFlushBuffer(stream);         /* handle error? */
     }
 
     /***********************************************************************
@@ -361,6 +455,7 @@ int BitFileClose(bit_file_t *stream)
     returnValue = fclose(stream->fp);
 
     /* free memory allocated for bit file */
+    free(stream->allocation);
     free(stream);
 
     return(returnValue);
@@ -378,10 +473,17 @@ int BitFileClose(bit_file_t *stream)
  * None
  *
  * \returns A FILE pointer to stream.  \c NULL for failure.
+ *
+ * Files are read a whole buffer at a time, so a stream open for reading
+ * may have read past the last bit returned.  Unread whole bytes are returned
+ * to the file with \c fseek.  Bytes read ahead from a stream that doesn't
+ * support seeking are lost.  Streams open for writing have their buffer
+ * written to the file.
  */
 FILE *BitFileToFILE(bit_file_t *stream)
 {
     FILE *fp = NULL;
+    size_t unread;
 
     if (stream == NULL)
     {
@@ -391,10 +493,18 @@ FILE *BitFileToFILE(bit_file_t *stream)
     if ((stream->mode == BF_WRITE) || (stream->mode == BF_APPEND))
     {
         /* write out any unwritten bits */
-        if (stream->bitCount != 0)
+        BitFileWritePending(stream, 0);     /* handle error? */
+        BitFileFlushBuffer(stream);         /* handle error? */
+    }
+    else
+    {
+        /* return whole bytes read ahead to the file */
+        unread = (stream->bitCount / 8) +
+            (stream->bufferEnd - stream->bufferIndex);
+
+        if (unread != 0)
         {
-            (stream->bitBuffer) <<= 8 - (stream->bitCount);
-            fputc(stream->bitBuffer, stream->fp);   /* handle error? */
+            fseek(stream->fp, -(long)unread, SEEK_CUR);
         }
     }
 
@@ -407,6 +517,7 @@ FILE *BitFileToFILE(bit_file_t *stream)
     fp = stream->fp;
 
     /* free memory allocated for bit file */
+    free(stream->allocation);
     free(stream);
 
     return(fp);
@@ -433,26 +544,36 @@ FILE *BitFileToFILE(bit_file_t *stream)
 int BitFileByteAlign(bit_file_t *stream)
 {
     int returnValue;
+    unsigned int spare;
 
     if (stream == NULL)
     {
         return(EOF);
     }
 
-    returnValue = stream->bitBuffer;
+    spare = stream->bitCount % 8;
 
     if ((stream->mode == BF_WRITE) || (stream->mode == BF_APPEND))
     {
+        returnValue = (int)(stream->bitBuffer & BF_MASK(spare));
+
         /* write out any unwritten bits */
-        if (stream->bitCount != 0)
+        if (BitFileWritePending(stream, 0) == EOF)
         {
-            (stream->bitBuffer) <<= 8 - (stream->bitCount);
-            fputc(stream->bitBuffer, stream->fp);   /* handle error? */
+            returnValue = EOF;
         }
     }
+    else
+    {
+        /* toss the unread bits of the current byte */
+        stream->bitCount -= spare;
+        returnValue = 0;
 
-    stream->bitBuffer = 0;
-    stream->bitCount = 0;
+        if (stream->bitCount < BF_WORD_BITS)
+        {
+            returnValue = (int)((stream->bitBuffer >> stream->bitCount) & 0xFF);
+        }
+    }
 
     return (returnValue);
 }
@@ -475,11 +596,13 @@ int BitFileByteAlign(bit_file_t *stream)
  * bit buffer value written.  -1 is returned if no data is written.
  *
  * This function flushes an output bit buffer.  This means left justifying
- * any pending bits, and filling spare bits with the fill value.
+ * any pending bits, filling spare bits with the fill value, and writing
+ * the I/O buffer to the file.
  */
 int BitFileFlushOutput(bit_file_t *stream, const unsigned char onesFill)
 {
     int returnValue;
+    unsigned int spare;
 
     if (stream == NULL)
     {
@@ -487,22 +610,25 @@ int BitFileFlushOutput(bit_file_t *stream, const unsigned char onesFill)
     }
 
     returnValue = -1;
+    spare = stream->bitCount % 8;
 
-    /* write out any unwritten bits */
-    if (stream->bitCount != 0)
+    if (spare != 0)
     {
-        stream->bitBuffer <<= (8 - stream->bitCount);
+        /* the partial byte, left justified and filled */
+        returnValue = (int)((stream->bitBuffer << (8 - spare)) & 0xFF);
 
         if (onesFill)
         {
-            stream->bitBuffer |= (0xFF >> stream->bitCount);
+            returnValue |= (0xFF >> spare);
         }
-
-        returnValue = fputc(stream->bitBuffer, stream->fp);
     }
 
-    stream->bitBuffer = 0;
-    stream->bitCount = 0;
+    /* write out any unwritten bits and the I/O buffer */
+    if ((BitFileWritePending(stream, onesFill) == EOF) ||
+        (BitFileFlushBuffer(stream) == EOF))
+    {
+        returnValue = EOF;
+    }
 
     return (returnValue);
 }
@@ -524,36 +650,19 @@ int BitFileFlushOutput(bit_file_t *stream, const unsigned char onesFill)
  */
 int BitFileGetChar(bit_file_t *stream)
 {
-    int returnValue;
-    unsigned char tmp;
+    bf_word_t value;
 
     if (stream == NULL)
     {
         return(EOF);
     }
 
-    returnValue = fgetc(stream->fp);
-
-    if (stream->bitCount == 0)
+    if (BitFileGetWord(stream, &value, 8) == EOF)
     {
-        /* we can just get byte from file */
-        return returnValue;
-    }
-
-    /* we have some buffered bits to return too */
-    if (returnValue != EOF)
-    {
-        /* figure out what to return */
-        tmp = ((unsigned char)returnValue) >> (stream->bitCount);
-        tmp |= ((stream->bitBuffer) << (8 - (stream->bitCount)));
-
-        /* put remaining in buffer. count shouldn't change. */
-        stream->bitBuffer = returnValue;
-
-        returnValue = tmp;
+        return EOF;
     }
 
-    return returnValue;
+    return (int)value;
 }
 
 /**
@@ -575,34 +684,17 @@ int BitFileGetChar(bit_file_t *stream)
  */
 int BitFilePutChar(const int c, bit_file_t *stream)
 {
-    unsigned char tmp;
-
     if (stream == NULL)
     {
         return(EOF);
     }
 
-    if (stream->bitCount == 0)
-    {
-        /* we can just put byte from file */
-        return fputc(c, stream->fp);
-    }
-
-    /* figure out what to write */
-    tmp = ((unsigned char)c) >> (stream->bitCount);
-    tmp = tmp | ((stream->bitBuffer) << (8 - stream->bitCount));
-
-    if (fputc(tmp, stream->fp) != EOF)
-    {
-        /* put remaining in buffer. count shouldn't change. */
-        stream->bitBuffer = c;
-    }
-    else
+    if (BitFilePutWord(stream, (bf_word_t)c, 8) == EOF)
     {
         return EOF;
     }
 
-    return tmp;
+    return (c & 0xFF);
 }
 
 /**
@@ -624,8 +716,6 @@ int BitFilePutChar(const int c, bit_file_t *stream)
  */
 int BitFileGetBit(bit_file_t *stream)
 {
-    int returnValue;
-
     if (stream == NULL)
     {
         return(EOF);
@@ -633,23 +723,17 @@ int BitFileGetBit(bit_file_t *stream)
 
     if (stream->bitCount == 0)
     {
-        /* buffer is empty, read another character */
-        if ((returnValue = fgetc(stream->fp)) == EOF)
+        /* buffer is empty, read another word */
+        if (BitFileReadWord(stream) == EOF)
         {
             return EOF;
         }
-        else
-        {
-            stream->bitCount = 8;
-            stream->bitBuffer = returnValue;
-        }
     }
 
     /* bit to return is msb in buffer */
     stream->bitCount--;
-    returnValue = (stream->bitBuffer) >> (stream->bitCount);
 
-    return (returnValue & 0x01);
+    return (int)((stream->bitBuffer >> stream->bitCount) & 0x01);
 }
 
 /**
@@ -686,17 +770,13 @@ int BitFilePutBit(const int c, bit_file_t *stream)
         stream->bitBuffer |= 1;
     }
 
-    /* write bit buffer if we have 8 bits */
-    if (stream->bitCount == 8)
+    /* write bit buffer if it's full */
+    if (stream->bitCount == BF_WORD_BITS)
     {
-        if (fputc(stream->bitBuffer, stream->fp) == EOF)
+        if (BitFileWriteWord(stream) == EOF)
         {
             returnValue = EOF;
         }
-
-        /* reset buffer */
-        stream->bitCount = 0;
-        stream->bitBuffer = 0;
     }
 
     return returnValue;
@@ -729,8 +809,9 @@ int BitFilePutBit(const int c, bit_file_t *stream)
  */
 int BitFileGetBits(bit_file_t *stream, void *bits, const unsigned int count)
 {
-    unsigned char *bytes, shifts;
-    int offset, remaining, returnValue;
+    unsigned char *bytes;
+    unsigned int offset, remaining, chunk, chunkBytes, i;
+    bf_word_t value;
 
     bytes = (unsigned char *)bits;
 
@@ -742,43 +823,29 @@ int BitFileGetBits(bit_file_t *stream, void *bits, const unsigned int count)
     offset = 0;
     remaining = count;
 
-    /* read whole bytes */
-    while (remaining >= 8)
+    /* read up to 7 whole bytes at a time */
+    while (remaining > 0)
     {
-        returnValue = BitFileGetChar(stream);
+        chunk = (remaining > (BF_WORD_BITS - 8)) ?
+            (BF_WORD_BITS - 8) : remaining;
 
-        if (returnValue == EOF)
+        if (BitFileGetWord(stream, &value, chunk) == EOF)
         {
             return EOF;
         }
 
-        bytes[offset] = (unsigned char)returnValue;
-        remaining -= 8;
-        offset++;
-    }
-
-    if (remaining != 0)
-    {
-        /* read remaining bits */
-        shifts = 8 - remaining;
-        bytes[offset] = 0;
+        /* left justify any partial byte */
+        chunkBytes = (chunk + 7) / 8;
+        value <<= (chunkBytes * 8) - chunk;
 
-        while (remaining > 0)
+        for (i = 0; i < chunkBytes; i++)
         {
-            returnValue = BitFileGetBit(stream);
-
-            if (returnValue == EOF)
-            {
-                return EOF;
-            }
-
-            bytes[offset] <<= 1;
-            bytes[offset] |= (returnValue & 0x01);
-            remaining--;
+            bytes[offset + i] =
+                (unsigned char)(value >> (8 * (chunkBytes - 1 - i)));
         }
 
-        /* shift last bits into position */
-        bytes[offset] <<= shifts;
+        remaining -= chunk;
+        offset += chunkBytes;
     }
 
     return count;
@@ -811,8 +878,9 @@ int BitFileGetBits(bit_file_t *stream, void *bits, const unsigned int count)
  */
 int BitFilePutBits(bit_file_t *stream, void *bits, const unsigned int count)
 {
-    unsigned char *bytes, tmp;
-    int offset, remaining, returnValue;
+    unsigned char *bytes;
+    unsigned int offset, remaining, chunk, chunkBytes, i;
+    bf_word_t value;
 
     bytes = (unsigned char *)bits;
 
@@ -824,37 +892,29 @@ int BitFilePutBits(bit_file_t *stream, void *bits, const unsigned int count)
     offset = 0;
     remaining = count;
 
-    /* write whole bytes */
-    while (remaining >= 8)
+    /* write up to 7 whole bytes at a time */
+    while (remaining > 0)
     {
-        returnValue = BitFilePutChar(bytes[offset], stream);
+        chunk = (remaining > (BF_WORD_BITS - 8)) ?
+            (BF_WORD_BITS - 8) : remaining;
+        chunkBytes = (chunk + 7) / 8;
+        value = 0;
 
-        if (returnValue == EOF)
+        for (i = 0; i < chunkBytes; i++)
         {
-            return EOF;
+            value = (value << 8) | bytes[offset + i];
         }
 
-        remaining -= 8;
-        offset++;
-    }
+        /* partial bytes are left justified */
+        value >>= (chunkBytes * 8) - chunk;
 
-    if (remaining != 0)
-    {
-        /* write remaining bits */
-        tmp = bytes[offset];
-
-        while (remaining > 0)
+        if (BitFilePutWord(stream, value, chunk) == EOF)
         {
-            returnValue = BitFilePutBit((tmp & 0x80), stream);
-
-            if (returnValue == EOF)
-            {
-                return EOF;
-            }
-
-            tmp <<= 1;
-            remaining--;
+            return EOF;
         }
+
+        remaining -= chunk;
+        offset += chunkBytes;
     }
 
     return count;
@@ -1251,6 +1311,338 @@ static int BitFilePutBitsBE(bit_file_t *stream, void *bits,
     return count;
 }
 
+/**
+ * \fn static int BitFileFillBuffer(bit_file_t *stream)
+ *
+ * \brief This function refills an empty I/O buffer from the file passed as
+ * a parameter.
+ *
+ * \param stream A pointer to the bit file stream to read from
+ *
+ * \effects
+ * Up to a buffer full of bytes are read from the file.
+ *
+ * \returns \c EOF if no bytes could be read, otherwise the number of bytes
+ * read.
+ */
+static int BitFileFillBuffer(bit_file_t *stream)
+{
+    stream->bufferIndex = 0;
+    stream->bufferEnd = fread(stream->buffer, 1, stream->bufferSize,
+        stream->fp);
+
+    if (stream->bufferEnd == 0)
+    {
+        return EOF;
+    }
+
+    return (int)stream->bufferEnd;
+}
+
+/**
+ * \fn static int BitFileFlushBuffer(bit_file_t *stream)
+ *
+ * \brief This function writes the contents of an I/O buffer to the file
+ * passed as a parameter.
+ *
+ * \param stream A pointer to the bit file stream to write to
+ *
+ * \effects
+ * The I/O buffer is written to the file and emptied.
+ *
+ * \returns \c EOF for failure, otherwise 0.
+ */
+static int BitFileFlushBuffer(bit_file_t *stream)
+{
+    size_t count;
+
+    count = stream->bufferIndex;
+    stream->bufferIndex = 0;
+
+    if (fwrite(stream->buffer, 1, count, stream->fp) != count)
+    {
+        return EOF;
+    }
+
+    return 0;
+}
+
+/**
+ * \fn static int BitFileReadWord(bit_file_t *stream)
+ *
+ * \brief This function refills an empty bit buffer with the next word in
+ * the file passed as a parameter.
+ *
+ * \param stream A pointer to the bit file stream to read from
+ *
+ * \effects
+ * Up to a word is moved from the I/O buffer into the bit buffer, most
+ * significant byte first.  The I/O buffer is refilled as needed.  Reaching
+ * the end of the file leaves fewer bits in the bit buffer.
+ *
+ * \returns \c EOF if no bytes could be read, otherwise the number of bits
+ * in the bit buffer.
+ */
+static int BitFileReadWord(bit_file_t *stream)
+{
+    const unsigned char *bytes;
+    unsigned int count;
+
+    stream->bitBuffer = 0;
+    stream->bitCount = 0;
+
+    if ((stream->bufferEnd - stream->bufferIndex) >= BF_WORD_BYTES)
+    {
+        /* the whole word is buffered */
+        bytes = stream->buffer + stream->bufferIndex;
+
+        for (count = 0; count < BF_WORD_BYTES; count++)
+        {
+            stream->bitBuffer = (stream->bitBuffer << 8) | bytes[count];
+        }
+
+        stream->bufferIndex += BF_WORD_BYTES;
+        stream->bitCount = BF_WORD_BITS;
+        return BF_WORD_BITS;
+    }
+
+    /* the word straddles a buffer refill */
+    for (count = 0; count < BF_WORD_BYTES; count++)
+    {
+        if (stream->bufferIndex == stream->bufferEnd)
+        {
+            if (BitFileFillBuffer(stream) == EOF)
+            {
+                break;
+            }
+        }
+
+        stream->bitBuffer = (stream->bitBuffer << 8) |
+            stream->buffer[stream->bufferIndex];
+        stream->bufferIndex++;
+    }
+
+    if (count == 0)
+    {
+        return EOF;
+    }
+
+    stream->bitCount = count * 8;
+    return (int)stream->bitCount;
+}
+
+/**
+ * \fn static int BitFileWriteWord(bit_file_t *stream)
+ *
+ * \brief This function moves a full bit buffer into the I/O buffer of the
+ * file passed as a parameter.
+ *
+ * \param stream A pointer to the bit file stream to write to
+ *
+ * \effects
+ * The bit buffer is added to the I/O buffer most significant byte first
+ * and emptied.  A full I/O buffer is written to the file.
+ *
+ * \returns \c EOF for failure, otherwise 0.
+ */
+static int BitFileWriteWord(bit_file_t *stream)
+{
+    unsigned char *bytes;
+    int i, returnValue;
+
+    returnValue = 0;
+
+    if ((stream->bufferSize - stream->bufferIndex) < BF_WORD_BYTES)
+    {
+        returnValue = BitFileFlushBuffer(stream);
+    }
+
+    bytes = stream->buffer + stream->bufferIndex;
+
+    for (i = 0; i < BF_WORD_BYTES; i++)
+    {
+        bytes[i] =
+            (unsigned char)(stream->bitBuffer >> (8 * (BF_WORD_BYTES - 1 - i)));
+    }
+
+    stream->bufferIndex += BF_WORD_BYTES;
+
+    /* reset buffer */
+    stream->bitBuffer = 0;
+    stream->bitCount = 0;
+
+    return returnValue;
+}
+
+/**
+ * \fn static int BitFileWritePending(bit_file_t *stream,
+ * const unsigned char fill)
+ *
+ * \brief This function moves every bit in an output bit buffer to the I/O
+ * buffer of the file passed as a parameter.
+ *
+ * \param stream A pointer to the bit file stream to write to
+ *
+ * \param fill set to non-zero if spare bits are to be filled with ones
+ *
+ * \effects
+ * Any partial byte is filled with ones or zeros, the bit buffer is added to
+ * the I/O buffer most significant byte first and emptied.  A full I/O
+ * buffer is written to the file.
+ *
+ * \returns \c EOF if a write fails, otherwise 0.
+ */
+static int BitFileWritePending(bit_file_t *stream, const unsigned char fill)
+{
+    unsigned int spare, count, i;
+    int returnValue;
+
+    spare = stream->bitCount % 8;
+
+    if (spare != 0)
+    {
+        /* left justify the partial byte and fill the spare bits */
+        spare = 8 - spare;
+        stream->bitBuffer <<= spare;
+
+        if (fill)
+        {
+            stream->bitBuffer |= BF_MASK(spare);
+        }
+
+        stream->bitCount += spare;
+    }
+
+    count = stream->bitCount / 8;
+    returnValue = 0;
+
+    if ((stream->bufferSize - stream->bufferIndex) < count)
+    {
+        returnValue = BitFileFlushBuffer(stream);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        stream->buffer[stream->bufferIndex] =
+            (unsigned char)(stream->bitBuffer >> (8 * (count - 1 - i)));
+        stream->bufferIndex++;
+    }
+
+    stream->bitBuffer = 0;
+    stream->bitCount = 0;
+
+    return returnValue;
+}
+
+/**
+ * \fn static int BitFileGetWord(bit_file_t *stream, bf_word_t *value,
+ * const unsigned int count)
+ *
+ * \brief This function reads up to a word of bits from the file passed as a
+ * parameter.
+ *
+ * \param stream A pointer to the bit file stream to read from
+ *
+ * \param value The address to store the bits read, right justified
+ *
+ * \param count The number of bits to read (0 to 64)
+ *
+ * \effects
+ * Reads bits from the bit buffer, refilling it from the file if it
+ * runs out.
+ *
+ * \returns \c EOF if the file ends before \c count bits are read,
+ * otherwise \c count.
+ *
+ * When the bit buffer holds \c count bits this is just a shift and a mask.
+ */
+static int BitFileGetWord(bit_file_t *stream, bf_word_t *value,
+    const unsigned int count)
+{
+    bf_word_t bits;
+    unsigned int needed;
+
+    if (stream->bitCount >= count)
+    {
+        stream->bitCount -= count;
+        *value = (stream->bitBuffer >> stream->bitCount) & BF_MASK(count);
+        return (int)count;
+    }
+
+    /* use what's in the buffer, then refill it for the rest */
+    needed = count - stream->bitCount;
+    bits = stream->bitBuffer & BF_MASK(stream->bitCount);
+    stream->bitCount = 0;
+
+    if ((BitFileReadWord(stream) == EOF) || (stream->bitCount < needed))
+    {
+        return EOF;
+    }
+
+    stream->bitCount -= needed;
+    bits = (needed == BF_WORD_BITS) ? 0 : (bits << needed);
+    *value = bits |
+        ((stream->bitBuffer >> stream->bitCount) & BF_MASK(needed));
+    return (int)count;
+}
+
+/**
+ * \fn static int BitFilePutWord(bit_file_t *stream, const bf_word_t value,
+ * const unsigned int count)
+ *
+ * \brief This function writes up to a word of bits to the file passed as a
+ * parameter.
+ *
+ * \param stream A pointer to the bit file stream to write to
+ *
+ * \param value The bits to write, right justified
+ *
+ * \param count The number of bits to write (0 to 64)
+ *
+ * \effects
+ * Adds bits to the bit buffer, writing it to the file when it fills.
+ *
+ * \returns \c EOF for failure, otherwise \c count.
+ *
+ * When the bit buffer has room for \c count bits this is just a shift and
+ * a mask.
+ */
+static int BitFilePutWord(bit_file_t *stream, const bf_word_t value,
+    const unsigned int count)
+{
+    unsigned int space, rest;
+
+    space = BF_WORD_BITS - stream->bitCount;
+
+    if (count < space)
+    {
+        stream->bitBuffer = (stream->bitBuffer << count) |
+            (value & BF_MASK(count));
+        stream->bitCount += count;
+        return (int)count;
+    }
+
+    /* fill the buffer, write it, and start a new one with the rest */
+    rest = count - space;
+
+    if (space != BF_WORD_BITS)
+    {
+        stream->bitBuffer <<= space;
+    }
+
+    stream->bitBuffer |= (value >> rest) & BF_MASK(space);
+    stream->bitCount = BF_WORD_BITS;
+
+    if (BitFileWriteWord(stream) == EOF)
+    {
+        return EOF;
+    }
+
+    stream->bitBuffer = value & BF_MASK(rest);
+    stream->bitCount = rest;
+    return (int)count;
+}
+
 /**
  * \fn static int BitFileNotSupported(bit_file_t *stream, void *bits,
  * const unsigned int count, const size_t size)
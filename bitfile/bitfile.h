@@ -69,6 +69,13 @@
 ***************************************************************************/
 #include <stdio.h>
 
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+
+/** The size of the I/O buffer used by BitFileOpen and MakeBitFile */
+#define BF_DEFAULT_BUFFER_SIZE  65536
+
 /***************************************************************************
 *                            TYPE DEFINITIONS
 ***************************************************************************/
@@ -102,6 +109,12 @@ typedef struct bit_file_t bit_file_t;
 /* open/close file */
 bit_file_t *BitFileOpen(const char *fileName, const BF_MODES mode);
 bit_file_t *MakeBitFile(FILE *stream, const BF_MODES mode);
+
+/* open/wrap file with an I/O buffer of bufferSize bytes */
+bit_file_t *BitFileOpenBuffered(const char *fileName, const BF_MODES mode,
+    const size_t bufferSize);
+bit_file_t *MakeBitFileBuffered(FILE *stream, const BF_MODES mode,
+    const size_t bufferSize);
 int BitFileClose(bit_file_t *stream);
 FILE *BitFileToFILE(bit_file_t *stream);
 
@@ -30,6 +30,10 @@
 *
 ***************************************************************************/
 
+/* ftruncate and the other POSIX interfaces aren't visible with -ansi */
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
 /***************************************************************************
 *                             INCLUDED FILES
 ***************************************************************************/
@@ -38,28 +42,255 @@
 #include <string.h>
 #include <limits.h>
 #include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "rice.h"
-#include "bitfile/bitfile.h"
+#include "ricesimd.h"
 
 /***************************************************************************
-*                            TYPE DEFINITIONS
+*                                CONSTANTS
 ***************************************************************************/
+#define TABLE_MIN_K     1       /* smallest k with decode tables */
+#define TABLE_MAX_K     7       /* largest k with lookup tables */
+#define ENCODE_MIN_K    0       /* smallest k with encode tables */
+
+#define ENCODE_SYMBOLS  256     /* number of encode table entries */
+#define ENCODE_BITS     (WINDOW_BITS - 7)   /* max bits appended at once */
+#define ENCODE_CHUNK    32      /* unary bits written at once by slow path */
+
+#define DECODE_BITS     12      /* bits in a decode table lookup window */
+#define DECODE_SYMBOLS  (DECODE_BITS / 2)   /* max codewords in a window */
+
+#define HISTOGRAMS      4       /* sub-histograms counted in parallel */
+#define AUTO_MAX_K      7       /* largest k considered by RiceBestK */
+
+#define ADAPT_SUM       4       /* initial sum of adaptive k symbols */
+#define ADAPT_COUNT     1       /* initial count of adaptive k symbols */
+#define ADAPT_RESET     64      /* count that halves sum and count */
+#define ADAPT_MAX_K     TABLE_MAX_K     /* largest adaptive k */
+
+#define NO_LIMIT        UINT_MAX    /* unary limit when escapes are off */
+#define MAX_WORD_K      31      /* largest k for 16 to 32 bit samples */
+#define MAX_WORD_BITS   32      /* widest sample */
+#define WORD_CHUNK      64      /* samples predicted at once */
+#define MAX_ORDER       3       /* highest fixed predictor order */
+
+#define HEADER_MAGIC    "RICE"  /* first 4 bytes of a sample header */
+#define HEADER_VERSION  1       /* sample header format version */
+#define HEADER_SIZE     20      /* bytes in a sample header */
+#define HEADER_FLAGS    10      /* offset of flags, then unused, length */
+#define HEADER_LENGTH_KNOWN 0x01    /* header holds the unencoded length */
+
+#define WINDOW_BITS     64      /* bits in a bit reader window */
+#define IO_BUFFER_SIZE  65536   /* bytes buffered between file and coder */
 
 /***************************************************************************
-*                                CONSTANTS
+*                            TYPE DEFINITIONS
 ***************************************************************************/
+/* codeword for a symbol, right justified */
+typedef struct
+{
+    uint64_t code;                          /* codeword bits */
+    unsigned int length;                    /* number of codeword bits */
+} encode_entry_t;
+
+/* every complete codeword in a DECODE_BITS wide window */
+typedef struct
+{
+    unsigned char symbols[DECODE_SYMBOLS];  /* decoded symbols */
+    unsigned char count;                    /* number of decoded symbols */
+    unsigned char bits;                     /* bits used by the symbols */
+} decode_entry_t;
+
+/* running statistics that pick k for each symbol in adaptive mode */
+typedef struct
+{
+    unsigned int sum;               /* sum of recent symbols */
+    unsigned int count;             /* number of recent symbols */
+} adapt_t;
+
+/* fixed predictor for signed samples */
+typedef struct
+{
+    unsigned int order;             /* predictor order, 0 to MAX_ORDER */
+    uint32_t last[MAX_ORDER];       /* last samples, most recent last */
+} predictor_t;
+
+/* msb first bit reader fed from a byte buffer that is refilled from fp */
+typedef struct
+{
+    uint64_t window;                /* unread bits, msb first */
+    unsigned int count;             /* number of valid bits in window */
+    const unsigned char *next;      /* next unread byte in buffer */
+    const unsigned char *end;       /* end of valid bytes in buffer */
+    unsigned char *buffer;          /* byte buffer */
+    size_t bufferSize;              /* size of byte buffer */
+    FILE *fp;                       /* source of bytes, NULL for memory */
+    unsigned int limit;             /* unary length of an escape */
+    unsigned int width;             /* bits in a symbol and an escape */
+    adapt_t adapt;                  /* adaptive k statistics */
+    uint64_t unary;                 /* 1s read of an unfinished codeword */
+} bit_reader_t;
+
+/* byte buffer that is flushed to fp when full */
+typedef struct
+{
+    unsigned char *next;            /* next free byte in buffer */
+    unsigned char *end;             /* end of buffer */
+    unsigned char *buffer;          /* byte buffer */
+    FILE *fp;                       /* destination, NULL for memory */
+    uint64_t flushed;               /* bytes written to fp */
+} byte_sink_t;
+
+/* msb first bit writer that drains whole bytes into a byte sink */
+typedef struct
+{
+    uint64_t bits;                  /* unwritten bits, right justified */
+    unsigned int count;             /* number of unwritten bits */
+    byte_sink_t sink;               /* destination of whole bytes */
+    unsigned int limit;             /* unary length of an escape */
+    unsigned int width;             /* bits in a symbol and an escape */
+    adapt_t adapt;                  /* adaptive k statistics */
+} bit_writer_t;
+
+/* incremental encoder or decoder state kept between calls */
+struct rice_stream_t
+{
+    rice_options_t options;         /* k, limit, width, order, predictor */
+    char encode;                    /* non-zero for an encoder */
+    bit_writer_t writer;            /* encoder bits not yet written */
+    bit_reader_t reader;            /* decoder bits not yet decoded */
+    predictor_t predictor;          /* signed sample predictor */
+    uint64_t unary;                 /* encoder unary 1s left to write */
+    uint32_t tail;                  /* encoder bits after the unary 1s */
+    unsigned int tailLength;        /* number of tail bits left to write */
+    uint64_t bound;                 /* longest (encoder) or shortest
+                                       (decoder) codeword in bits */
+    unsigned int size;              /* bytes in a sample */
+    unsigned char sample[MAX_WORD_BITS / CHAR_BIT];    /* split sample */
+    unsigned int have;              /* bytes in sample */
+    unsigned int next;              /* next decoded byte in sample */
+};
 
 /***************************************************************************
 *                                  MACROS
 ***************************************************************************/
+/* number of 0s before the most significant 1 in a non-zero uint64_t */
+#if defined(__GNUC__)
+#define CLZ64(x)    ((unsigned int)__builtin_clzll(x))    /* LZCNT/BSR */
+#else
+#define CLZ64(x)    CountLeadingZeros(x)
+#endif
+
+/* the top n bits of a bit reader window (0 < n < WINDOW_BITS) */
+#define PEEK_BITS(reader, n)    ((unsigned int)((reader)->window >> \
+    (WINDOW_BITS - (n))))
+
+/* longest unary portion of a codeword for a byte */
+#define MAX_UNARY(k)    ((unsigned int)(((k) < CHAR_BIT) ? (UCHAR_MAX >> (k)) : 0))
+
+/* longest unary portion of a codeword for a width bit symbol */
+#define MAX_WORD_UNARY(width, k)    (((k) < WINDOW_BITS) ? \
+    (((((uint64_t)1) << (width)) - 1) >> (k)) : 0)
+
+/* bytes in a sample of a rice_options_t width */
+#define SAMPLE_BYTES(width) ((0 == (width)) ? 1 : ((width) / CHAR_BIT))
+
+/* map a width bit two's complement value to unsigned (0, -1, 1, -2, ...) */
+#define ZIGZAG(value, top, mask)    ((((value) << 1) ^ \
+    (0 - ((value) >> (top)))) & (mask))
+
+/* undo ZIGZAG */
+#define UNZIGZAG(value, mask)   ((((value) >> 1) ^ (0 - ((value) & 1))) & \
+    (mask))
+
+/* unary limit of a bit reader or writer for a rice_options_t limit */
+#define UNARY_LIMIT(limit)  ((0 == (limit)) ? NO_LIMIT : (limit))
 
 /***************************************************************************
 *                            GLOBAL VARIABLES
 ***************************************************************************/
+/* encode tables for each k, built the first time they're needed */
+static encode_entry_t encodeTable[TABLE_MAX_K - ENCODE_MIN_K + 1]
+    [ENCODE_SYMBOLS];
+static char encodeTableReady[TABLE_MAX_K - ENCODE_MIN_K + 1] = {0};
+
+/* decode tables for each k, built the first time they're needed */
+static decode_entry_t decodeTable[TABLE_MAX_K - TABLE_MIN_K + 1]
+    [1 << DECODE_BITS];
+static char decodeTableReady[TABLE_MAX_K - TABLE_MIN_K + 1] = {0};
+
+/* non-zero if the AVX2 encoder may be used, -1 until checked */
+static int useAvx2 = -1;
+
+/* non-zero if the BMI2 decoder may be used, -1 until checked */
+static int useBmi2 = -1;
 
 /***************************************************************************
 *                               PROTOTYPES
 ***************************************************************************/
+static void CountSymbols(const unsigned char *bytes, const size_t count,
+    size_t *histogram);
+
+static const encode_entry_t *GetEncodeTable(const unsigned char k);
+static const decode_entry_t *GetDecodeTable(const unsigned char k);
+
+static int WriterDrain(bit_writer_t *writer);
+static int EncodeSlow(bit_writer_t *writer, const unsigned char k,
+    const uint32_t symbol);
+static int EncodeBytes(bit_writer_t *writer, const unsigned char *bytes,
+    const size_t count, const unsigned char k);
+static int EncodeAdaptive(bit_writer_t *writer, const unsigned char *bytes,
+    const size_t count);
+static int EncodeWords(bit_writer_t *writer, const unsigned char *bytes,
+    const size_t count, const rice_options_t *options,
+    predictor_t *predictor);
+static void LoadSamples(const unsigned char *bytes, const unsigned int count,
+    const unsigned int size, const unsigned char order, uint32_t *samples);
+static void PredictResiduals(const uint32_t *samples,
+    const unsigned int count, const unsigned int order,
+    const unsigned int width, uint32_t *residuals);
+static int WriterFlush(bit_writer_t *writer);
+
+static void ReaderRefill(bit_reader_t *reader);
+static int DecodeSlow(bit_reader_t *reader, const unsigned char k,
+    uint32_t *symbol);
+static int DecodeStream(bit_reader_t *reader, byte_sink_t *sink,
+    const unsigned char k);
+static int DecodeAdaptive(bit_reader_t *reader, byte_sink_t *sink);
+static int DecodeWords(bit_reader_t *reader, byte_sink_t *sink,
+    const rice_options_t *options, predictor_t *predictor);
+static uint32_t PredictSample(predictor_t *predictor, const uint32_t residual,
+    const uint32_t mask);
+static int CheckSampleOptions(const rice_options_t *options);
+static void PredictorInit(predictor_t *predictor, const unsigned char mode);
+static void PutHeader(unsigned char *header, const rice_options_t *options,
+    const uint64_t length, const int known);
+static int PatchHeaderLength(FILE *fp, const off_t header,
+    const uint64_t length);
+static int ReadHeader(FILE *fp, rice_options_t *options, uint64_t *length,
+    int *known);
+static off_t PreallocateOutput(FILE *fp, const uint64_t length);
+static rice_stream_t *StreamNew(const rice_options_t *options,
+    const char encode);
+static int StreamEmit(rice_stream_t *stream);
+static void StreamEncodeSample(rice_stream_t *stream,
+    const unsigned char *bytes);
+static int StreamPutSample(rice_stream_t *stream, byte_sink_t *sink);
+static void StreamStoreSymbol(rice_stream_t *stream, uint32_t symbol);
+static void StoreSample(unsigned char *bytes, uint32_t sample,
+    const unsigned int size, const unsigned char order);
+#if !defined(__GNUC__)
+static unsigned int CountLeadingZeros(uint64_t word);
+#endif
+
+static int SinkFlush(byte_sink_t *sink);
+
+static void AdaptInit(adapt_t *adapt);
+static unsigned char AdaptK(const adapt_t *adapt);
+static void AdaptUpdate(adapt_t *adapt, const unsigned char symbol);
 
 /***************************************************************************
 *                                FUNCTIONS
@@ -67,8 +298,10 @@
 
 /***************************************************************************
 *   Function   : RiceEncodeFile
-*   Description: This routine reads an input file 1 character at a time and
-*                writes out a Rice encoded version of that file.
+*   Description: This routine reads an input file and writes out a Rice
+*                encoded version of that file.  Codewords are looked up in
+*                a table and appended to a 64 bit accumulator that is
+*                drained into a buffered output a byte at a time.
 *   Parameters : inFile - pointer to open file to encode
 *                outFile - pointer to open file receiving encoded output
 *                k - length of binary portion of encoded word
@@ -80,11 +313,10 @@
 ***************************************************************************/
 int RiceEncodeFile(FILE *inFile, FILE *outFile, const unsigned char k)
 {
-    bit_file_t *bOutFile;               /* encoded output */
-    unsigned char unary;                /* unary portion */
-    unsigned char binary;               /* binary portion */
-    unsigned char mask;                 /* mask for binary portion */
-    int c;
+    bit_writer_t writer;                /* encoded output */
+    unsigned char *buffer;              /* unencoded input */
+    size_t read;
+    int result;
 
     /* validate input and output files */
     if ((NULL == inFile) || (NULL == outFile))
@@ -93,63 +325,383 @@ int RiceEncodeFile(FILE *inFile, FILE *outFile, const unsigned char k)
         return -1;
     }
 
-    bOutFile = MakeBitFile(outFile, BF_WRITE);
+    buffer = (unsigned char *)malloc(IO_BUFFER_SIZE);
+    writer.sink.buffer = (unsigned char *)malloc(IO_BUFFER_SIZE);
 
-    if (NULL == bOutFile)
+    if ((NULL == buffer) || (NULL == writer.sink.buffer))
     {
-        perror("Making Output File a BitFile");
+        perror("Allocating Encode Buffers");
+        free(buffer);
+        free(writer.sink.buffer);
+        errno = ENOMEM;
         return -1;
     }
 
-    mask =  0xFF >> (CHAR_BIT - k);
+    writer.bits = 0;
+    writer.count = 0;
+    writer.limit = NO_LIMIT;
+    writer.width = CHAR_BIT;
+    AdaptInit(&writer.adapt);
+    writer.sink.next = writer.sink.buffer;
+    writer.sink.end = writer.sink.buffer + IO_BUFFER_SIZE;
+    writer.sink.fp = outFile;
+    writer.sink.flushed = 0;
 
-    /* encode input file one byte at a time */
-    while ((c = fgetc(inFile)) != EOF)
+    result = 0;
+
+    /* encode input file one buffer at a time */
+    while ((read = fread(buffer, 1, IO_BUFFER_SIZE, inFile)) != 0)
     {
-        /* compute the unary portion */
-        unary = (unsigned char)c;
-        unary >>= k;
+        result = EncodeBytes(&writer, buffer, read, k);
 
-        while (unary > 0)
+        if (0 != result)
         {
-            /* write out unary worth of 1s */
-            unary--;
-            BitFilePutBit(1, bOutFile);
+            break;
         }
+    }
+
+    if (0 == result)
+    {
+        /* pad fill with 1s so decode will run into EOF */
+        result = WriterFlush(&writer);
+    }
+
+    free(buffer);
+    free(writer.sink.buffer);
+    return result;
+}
+
+/***************************************************************************
+*   Function   : RiceEncodeBuffer
+*   Description: This routine writes a Rice encoded version of a buffer of
+*                bytes to caller supplied memory.  No FILE or heap memory
+*                is used.
+*   Parameters : in - pointer to bytes to encode
+*                n - number of bytes to encode
+*                out - pointer to memory receiving encoded output
+*                cap - size of out in bytes
+*                k - length of binary portion of encoded word
+*   Effects    : in is encoded using the Rice algorithm with a k bit binary
+*                portion.  The last byte is padded with 1s, just like
+*                RiceEncodeFile.
+*   Returned   : The number of bytes written to out, or RICE_ERROR for
+*                failure.  errno will be set in the event of a failure
+*                (ENOBUFS if the output doesn't fit in cap bytes).
+***************************************************************************/
+size_t RiceEncodeBuffer(const uint8_t *in, const size_t n, uint8_t *out,
+    const size_t cap, const unsigned char k)
+{
+    rice_options_t options;
+
+    memset(&options, 0, sizeof(options));
+    options.k = k;
+    return RiceEncodeBufferEx(in, n, out, cap, &options);
+}
 
-        /* write an ending 0 */
-        BitFilePutBit(0, bOutFile);
+/***************************************************************************
+*   Function   : RiceEncodeBufferEx
+*   Description: This routine writes a Rice encoded version of a buffer of
+*                bytes to caller supplied memory using the k and unary
+*                limit from a rice_options_t.  Symbols with a unary portion
+*                of limit or more bits are written as an escape: limit 1s
+*                without an ending 0, followed by the symbol's ESCAPE_BITS
+*                bits.  No FILE or heap memory is used.
+*   Parameters : in - pointer to bytes to encode
+*                n - number of bytes to encode
+*                out - pointer to memory receiving encoded output
+*                cap - size of out in bytes
+*                options - pointer to options, only k and limit are used
+*   Effects    : in is encoded using the Rice algorithm with a k bit binary
+*                portion.  The last byte is padded with 1s, just like
+*                RiceEncodeFile.
+*   Returned   : The number of bytes written to out, or RICE_ERROR for
+*                failure.  errno will be set in the event of a failure
+*                (ENOBUFS if the output doesn't fit in cap bytes).
+***************************************************************************/
+size_t RiceEncodeBufferEx(const uint8_t *in, const size_t n, uint8_t *out,
+    const size_t cap, const rice_options_t *options)
+{
+    bit_writer_t writer;                /* encoded output */
 
-        /* binary portion */
-        binary = (unsigned char)c & mask;
-        binary <<= (CHAR_BIT - k);      /* right justify bits */
-        BitFilePutBits(bOutFile, &binary, k);
+    if (((NULL == in) && (0 != n)) || ((NULL == out) && (0 != cap)) ||
+        (NULL == options) || (options->limit > RICE_MAX_LIMIT))
+    {
+        errno = EINVAL;
+        return RICE_ERROR;
     }
 
-    /* pad fill with 1s so decode will run into EOF */
-    BitFileFlushOutput(bOutFile, 1);
-    return 0;
+    writer.bits = 0;
+    writer.count = 0;
+    writer.limit = UNARY_LIMIT(options->limit);
+    writer.width = CHAR_BIT;
+    AdaptInit(&writer.adapt);
+    writer.sink.buffer = out;
+    writer.sink.next = out;
+    writer.sink.end = out + cap;
+    writer.sink.fp = NULL;
+    writer.sink.flushed = 0;
+
+    if ((0 != EncodeBytes(&writer, in, n, options->k)) ||
+        (0 != WriterFlush(&writer)))
+    {
+        return RICE_ERROR;
+    }
+
+    return writer.sink.next - writer.sink.buffer;
 }
 
 /***************************************************************************
-*   Function   : RiceDecodeFile
-*   Description: This routine reads a rice encoded input file and writes
-*                the decoded output one byte at a time.
+*   Function   : RiceDecodeBuffer
+*   Description: This routine writes the decoded version of a buffer of
+*                Rice encoded bytes to caller supplied memory.  No FILE or
+*                heap memory is used.
+*   Parameters : in - pointer to bytes to decode
+*                n - number of bytes to decode
+*                out - pointer to memory receiving decoded output
+*                cap - size of out in bytes
+*                k - length of binary portion of encoded word
+*   Effects    : in is decoded using the Rice algorithm for codes with a k
+*                bit binary portion.
+*   Returned   : The number of bytes written to out, or RICE_ERROR for
+*                failure.  errno will be set in the event of a failure
+*                (ENOBUFS if the output doesn't fit in cap bytes).
+***************************************************************************/
+size_t RiceDecodeBuffer(const uint8_t *in, const size_t n, uint8_t *out,
+    const size_t cap, const unsigned char k)
+{
+    rice_options_t options;
+
+    memset(&options, 0, sizeof(options));
+    options.k = k;
+    return RiceDecodeBufferEx(in, n, out, cap, &options);
+}
+
+/***************************************************************************
+*   Function   : RiceDecodeBufferEx
+*   Description: This routine writes the decoded version of a buffer of
+*                Rice encoded bytes to caller supplied memory using the k
+*                and unary limit from a rice_options_t.  They must match
+*                the options used to encode the buffer.  No FILE or heap
+*                memory is used.
+*   Parameters : in - pointer to bytes to decode
+*                n - number of bytes to decode
+*                out - pointer to memory receiving decoded output
+*                cap - size of out in bytes
+*                options - pointer to options, only k and limit are used
+*   Effects    : in is decoded using the Rice algorithm for codes with a k
+*                bit binary portion.
+*   Returned   : The number of bytes written to out, or RICE_ERROR for
+*                failure.  errno will be set in the event of a failure
+*                (ENOBUFS if the output doesn't fit in cap bytes, EILSEQ
+*                for a codeword that isn't a byte).
+***************************************************************************/
+size_t RiceDecodeBufferEx(const uint8_t *in, const size_t n, uint8_t *out,
+    const size_t cap, const rice_options_t *options)
+{
+    bit_reader_t reader;                /* encoded input */
+    byte_sink_t sink;                   /* decoded output */
+
+    if (((NULL == in) && (0 != n)) || ((NULL == out) && (0 != cap)) ||
+        (NULL == options) || (options->limit > RICE_MAX_LIMIT))
+    {
+        errno = EINVAL;
+        return RICE_ERROR;
+    }
+
+    reader.window = 0;
+    reader.count = 0;
+    reader.next = in;
+    reader.end = in + n;
+    reader.buffer = NULL;
+    reader.bufferSize = 0;
+    reader.fp = NULL;
+    reader.limit = UNARY_LIMIT(options->limit);
+    reader.width = CHAR_BIT;
+    AdaptInit(&reader.adapt);
+    reader.unary = 0;
+
+    sink.buffer = out;
+    sink.next = out;
+    sink.end = out + cap;
+    sink.fp = NULL;
+    sink.flushed = 0;
+
+    if (0 != DecodeStream(&reader, &sink, options->k))
+    {
+        return RICE_ERROR;
+    }
+
+    return sink.next - sink.buffer;
+}
+
+/***************************************************************************
+*   Function   : RiceEncodeSamples
+*   Description: This routine reads an input file of 8, 16, 24, or 32 bit
+*                samples and writes out a Rice encoded version of that
+*                file.  Each sample is one symbol, so wide samples aren't
+*                split into bytes that are coded separately.  Signed
+*                samples are replaced by their zigzagged predictor
+*                residuals as they are coded.  Wide codewords are built
+*                from the symbol instead of being looked up in a table.
+*   Parameters : inFile - pointer to open file to encode
+*                outFile - pointer to open file receiving encoded output
+*                options - pointer to k (0 - 31), limit, sample width,
+*                          sample byte order, predictor, and flags
+*   Effects    : File is encoded using the Rice algorithm with a k bit
+*                binary portion.  With RICE_FLAG_HEADER the options and
+*                unencoded length are written in a header before the
+*                codewords.  The length is only filled in if outFile can
+*                seek.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure (EINVAL if inFile ends in the middle
+*                of a sample).  Either way, inFile and outFile will be
+*                left open.
+***************************************************************************/
+int RiceEncodeSamples(FILE *inFile, FILE *outFile,
+    const rice_options_t *options)
+{
+    bit_writer_t writer;                /* encoded output */
+    predictor_t predictor;              /* signed sample predictor */
+    unsigned char *buffer;              /* unencoded input */
+    size_t size, read, kept, samples;
+    uint64_t length;                    /* unencoded bytes */
+    off_t header;                       /* position of header in outFile */
+    int result;
+
+    /* validate input and output files */
+    if ((NULL == inFile) || (NULL == outFile))
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    if (0 != CheckSampleOptions(options))
+    {
+        return -1;
+    }
+
+    buffer = (unsigned char *)malloc(IO_BUFFER_SIZE);
+    writer.sink.buffer = (unsigned char *)malloc(IO_BUFFER_SIZE);
+
+    if ((NULL == buffer) || (NULL == writer.sink.buffer))
+    {
+        perror("Allocating Encode Buffers");
+        free(buffer);
+        free(writer.sink.buffer);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    size = SAMPLE_BYTES(options->width);
+    writer.bits = 0;
+    writer.count = 0;
+    writer.limit = UNARY_LIMIT(options->limit);
+    writer.width = size * CHAR_BIT;
+    AdaptInit(&writer.adapt);
+    writer.sink.next = writer.sink.buffer;
+    writer.sink.end = writer.sink.buffer + IO_BUFFER_SIZE;
+    writer.sink.fp = outFile;
+    writer.sink.flushed = 0;
+    PredictorInit(&predictor, options->predictor);
+
+    header = -1;
+
+    if (options->flags & RICE_FLAG_HEADER)
+    {
+        /* the length isn't known yet, it's filled in at the end */
+        header = ftello(outFile);
+        PutHeader(writer.sink.next, options, 0, 0);
+        writer.sink.next += HEADER_SIZE;
+    }
+
+    result = 0;
+    kept = 0;
+    length = 0;
+
+    /* encode input file one buffer of whole samples at a time */
+    while ((read = fread(buffer + kept, 1, IO_BUFFER_SIZE - kept, inFile))
+        != 0)
+    {
+        length += read;
+        read += kept;
+        samples = read / size;
+
+        if ((1 == size) && (RICE_UNSIGNED == options->predictor))
+        {
+            /* bytes have encode tables and kernels */
+            result = EncodeBytes(&writer, buffer, samples, options->k);
+        }
+        else
+        {
+            result = EncodeWords(&writer, buffer, samples, options,
+                &predictor);
+        }
+
+        if (0 != result)
+        {
+            break;
+        }
+
+        /* keep the start of a sample split between reads */
+        kept = read - (samples * size);
+        memmove(buffer, buffer + (samples * size), kept);
+    }
+
+    if ((0 == result) && (0 != kept))
+    {
+        /* partial sample at the end of the file */
+        errno = EINVAL;
+        result = -1;
+    }
+
+    if (0 == result)
+    {
+        /* pad fill with 1s so decode will run into EOF */
+        result = WriterFlush(&writer);
+    }
+
+    if ((0 == result) && (-1 != header))
+    {
+        result = PatchHeaderLength(outFile, header, length);
+    }
+
+    free(buffer);
+    free(writer.sink.buffer);
+    return result;
+}
+
+/***************************************************************************
+*   Function   : RiceDecodeSamples
+*   Description: This routine reads a file written by RiceEncodeSamples
+*                and writes the decoded samples.
 *   Parameters : inFile - pointer to open file to decode
 *                outFile - pointer to open file receiving decoded output
-*                k - length of binary portion of encoded word
+*                options - pointer to k (0 - 31), limit, sample width,
+*                          sample byte order, predictor, and flags.  They
+*                          must match the options used to encode inFile.
+*                          Only the flags are used with RICE_FLAG_HEADER,
+*                          everything else comes from the header.
 *   Effects    : File is decoded using the Rice algorithm for codes with a
-*                k bit binary portion.
+*                k bit binary portion.  If the header has the unencoded
+*                length, a regular outFile is extended to its final size
+*                before decoding.
 *   Returned   : 0 for success, -1 for failure.  errno will be set in the
-*                event of a failure.  Either way, inFile and outFile will
-*                be left open.
+*                event of a failure (EILSEQ for a codeword wider than a
+*                sample, a bad header, or a stream that doesn't decode to
+*                the length in its header).  Either way, inFile and
+*                outFile will be left open.
 ***************************************************************************/
-int RiceDecodeFile(FILE *inFile, FILE *outFile, const unsigned char k)
+int RiceDecodeSamples(FILE *inFile, FILE *outFile,
+    const rice_options_t *options)
 {
-    bit_file_t *bInFile;                /* encoded input */
-    int bit;
-    unsigned char tmp;
-    unsigned char byte;
+    bit_reader_t reader;                /* encoded input */
+    byte_sink_t sink;                   /* decoded output */
+    predictor_t predictor;              /* signed sample predictor */
+    rice_options_t stream;              /* options from the stream header */
+    uint64_t length;                    /* unencoded bytes */
+    int known;                          /* non-zero if length is known */
+    off_t start;                        /* start of preallocated output */
+    int result;
 
     /* validate input and output files */
     if ((NULL == inFile) || (NULL == outFile))
@@ -158,41 +710,2456 @@ int RiceDecodeFile(FILE *inFile, FILE *outFile, const unsigned char k)
         return -1;
     }
 
-    bInFile = MakeBitFile(inFile, BF_READ);
+    if (0 != CheckSampleOptions(options))
+    {
+        return -1;
+    }
+
+    known = 0;
+    length = 0;
+    start = -1;
+
+    if (options->flags & RICE_FLAG_HEADER)
+    {
+        /* the stream describes itself, options from the caller aren't used */
+        if (0 != ReadHeader(inFile, &stream, &length, &known))
+        {
+            return -1;
+        }
+
+        options = &stream;
+
+        if (known)
+        {
+            start = PreallocateOutput(outFile, length);
+        }
+    }
+
+    reader.buffer = (unsigned char *)malloc(IO_BUFFER_SIZE);
+    sink.buffer = (unsigned char *)malloc(IO_BUFFER_SIZE);
 
-    if (NULL == bInFile)
+    if ((NULL == reader.buffer) || (NULL == sink.buffer))
     {
-        perror("Making Input File a BitFile");
+        perror("Allocating Decode Buffers");
+        free(reader.buffer);
+        free(sink.buffer);
+        errno = ENOMEM;
         return -1;
     }
 
-    byte = 0;
+    reader.window = 0;
+    reader.count = 0;
+    reader.next = reader.buffer;
+    reader.end = reader.buffer;
+    reader.bufferSize = IO_BUFFER_SIZE;
+    reader.fp = inFile;
+    reader.limit = UNARY_LIMIT(options->limit);
+    reader.width = SAMPLE_BYTES(options->width) * CHAR_BIT;
+    AdaptInit(&reader.adapt);
+    reader.unary = 0;
+
+    sink.next = sink.buffer;
+    sink.end = sink.buffer + IO_BUFFER_SIZE;
+    sink.fp = outFile;
+    sink.flushed = 0;
+    PredictorInit(&predictor, options->predictor);
+
+    if ((CHAR_BIT == reader.width) &&
+        (RICE_UNSIGNED == options->predictor))
+    {
+        /* bytes have decode tables and kernels */
+        result = DecodeStream(&reader, &sink, options->k);
+    }
+    else
+    {
+        result = DecodeWords(&reader, &sink, options, &predictor);
+    }
+
+    if (0 == result)
+    {
+        result = SinkFlush(&sink);
+    }
+
+    if ((0 == result) && known && (sink.flushed != length))
+    {
+        /* truncated stream or wrong length */
+        errno = EILSEQ;
+        result = -1;
+    }
 
-    /* decode input file */
-    while ((bit = BitFileGetBit(bInFile)) != EOF)
+    if ((0 != result) && (-1 != start) && (0 == fflush(outFile)))
     {
-        if (1 == bit)
+        /* don't leave preallocated space that looks like decoded data */
+        if (0 != ftruncate(fileno(outFile), start + (off_t)sink.flushed))
         {
-            byte++;
+            result = -1;
         }
-        else
+    }
+
+    free(reader.buffer);
+    free(sink.buffer);
+    return result;
+}
+
+/***************************************************************************
+*   Function   : RiceEncodeInit
+*   Description: This routine starts an incremental encoder for data that
+*                arrives in pieces, like network reads.  The stream is fed
+*                with RiceEncodeUpdate and ended with RiceEncodeFinish.
+*                The encoded output is the same as RiceEncodeSamples (and
+*                RiceEncodeFile for bytes) would write for all of the
+*                pieces at once, no matter how the input and output are
+*                split up.  The stream's memory doesn't grow with its
+*                length or with the length of a codeword.
+*   Parameters : options - pointer to k (0 - 31 or RICE_ADAPTIVE_K for
+*                          unsigned bytes), limit, sample width, sample
+*                          byte order, and predictor.  flags must be 0.
+*   Effects    : Memory for the stream is allocated.
+*   Returned   : Pointer to the stream, or NULL for failure.  errno will
+*                be set in the event of a failure.  The stream must be
+*                freed with RiceStreamFree.
+***************************************************************************/
+rice_stream_t *RiceEncodeInit(const rice_options_t *options)
+{
+    rice_stream_t *stream;
+    uint64_t unary;
+    unsigned char k;
+
+    stream = StreamNew(options, 1);
+
+    if (NULL == stream)
+    {
+        return NULL;
+    }
+
+    /* longest codeword, adaptive codewords are no longer than 0 and 7 */
+    k = (RICE_ADAPTIVE_K == options->k) ? 0 : options->k;
+    unary = MAX_WORD_UNARY(stream->writer.width, k);
+
+    if (unary >= stream->writer.limit)
+    {
+        unary = stream->writer.limit - 1;
+    }
+
+    k = (RICE_ADAPTIVE_K == options->k) ? ADAPT_MAX_K : options->k;
+    stream->bound = unary + 1 + k;
+
+    if ((NO_LIMIT != stream->writer.limit) &&
+        ((uint64_t)stream->writer.limit + stream->writer.width >
+        stream->bound))
+    {
+        stream->bound = stream->writer.limit + stream->writer.width;
+    }
+
+    return stream;
+}
+
+/***************************************************************************
+*   Function   : RiceEncodeUpdate
+*   Description: This routine encodes the next piece of a stream started
+*                by RiceEncodeInit.  While there's plenty of room in out,
+*                whole samples are encoded as many at a time as are sure
+*                to fit, using the same tables and kernels as the file
+*                functions.  When out is nearly full, samples are encoded
+*                one at a time and a codeword that doesn't fit is kept in
+*                the stream and finished by the next call.  A sample that
+*                is split between calls is kept until the rest arrives.
+*   Parameters : stream - pointer to stream from RiceEncodeInit
+*                in - pointer to bytes to encode
+*                n - pointer to the number of bytes in in, set to the
+*                    number of bytes used.  Bytes are only left unused
+*                    when out is full.
+*                out - pointer to memory receiving encoded output
+*                cap - size of out in bytes
+*   Effects    : Input is encoded and the stream is updated.
+*   Returned   : The number of bytes written to out, or RICE_ERROR for
+*                failure.  errno will be set in the event of a failure.
+***************************************************************************/
+size_t RiceEncodeUpdate(rice_stream_t *stream, const uint8_t *in, size_t *n,
+    uint8_t *out, const size_t cap)
+{
+    bit_writer_t *writer;
+    size_t used, count, room;
+    uint64_t fit;
+    int result;
+
+    if ((NULL == stream) || !stream->encode || (NULL == n) ||
+        ((NULL == in) && (0 != *n)) || ((NULL == out) && (0 != cap)))
+    {
+        errno = EINVAL;
+        return RICE_ERROR;
+    }
+
+    writer = &stream->writer;
+    writer->sink.buffer = out;
+    writer->sink.next = out;
+    writer->sink.end = out + cap;
+    used = 0;
+
+    /* each pass starts with the last codeword written */
+    while (StreamEmit(stream))
+    {
+        if ((0 != stream->have) || ((*n - used) < stream->size))
         {
-            /* finished unary portion */
-            tmp = byte << k;
+            /* gather a sample that is split between calls */
+            count = stream->size - stream->have;
+            count = (count < (*n - used)) ? count : (*n - used);
+            memcpy(stream->sample + stream->have, in + used, count);
+            stream->have += count;
+            used += count;
 
-            if (EOF == BitFileGetBits(bInFile, &byte, k))
+            if (stream->have < stream->size)
             {
-                /* unary was actually spare bits */
                 break;
             }
 
-            byte >>= (CHAR_BIT - k);        /* left justify bits */
-            byte |= tmp;
-            fputc(byte, outFile);
+            StreamEncodeSample(stream, stream->sample);
+            stream->have = 0;
+            continue;
+        }
+
+        /* whole samples whose longest codewords all fit in out */
+        room = writer->sink.end - writer->sink.next;
+        fit = (0 == room) ? 0 :
+            (((uint64_t)(room - 1) * CHAR_BIT) / stream->bound);
+        count = (*n - used) / stream->size;
+        count = (fit < count) ? (size_t)fit : count;
+
+        if (0 == count)
+        {
+            /* out is nearly full, write what fits of one codeword */
+            StreamEncodeSample(stream, in + used);
+            used += stream->size;
+            continue;
+        }
+
+        if ((1 == stream->size) &&
+            (RICE_UNSIGNED == stream->options.predictor))
+        {
+            result = EncodeBytes(writer, in + used, count, stream->options.k);
+        }
+        else
+        {
+            result = EncodeWords(writer, in + used, count, &stream->options,
+                &stream->predictor);
+        }
 
-            byte = 0;
+        if ((0 != result) || (0 != WriterDrain(writer)))
+        {
+            return RICE_ERROR;
         }
+
+        used += count * stream->size;
     }
 
-    return 0;
+    *n = used;
+    return writer->sink.next - writer->sink.buffer;
+}
+
+/***************************************************************************
+*   Function   : RiceEncodeFinish
+*   Description: This routine writes the end of a stream started by
+*                RiceEncodeInit: the rest of the last codeword and the 1s
+*                padding the last byte.
+*   Parameters : stream - pointer to stream from RiceEncodeInit
+*                out - pointer to memory receiving encoded output
+*                cap - size of out in bytes
+*   Effects    : The end of the stream is written to out.  If it doesn't
+*                all fit, the rest is kept for the next call.
+*   Returned   : The number of bytes written to out, or RICE_ERROR for
+*                failure.  errno will be set in the event of a failure
+*                (EINVAL if the input ended in the middle of a sample).
+*                The stream is finished when fewer than cap bytes are
+*                written.
+***************************************************************************/
+size_t RiceEncodeFinish(rice_stream_t *stream, uint8_t *out,
+    const size_t cap)
+{
+    bit_writer_t *writer;
+    unsigned int pad;
+
+    if ((NULL == stream) || !stream->encode || (0 != stream->have) ||
+        ((NULL == out) && (0 != cap)))
+    {
+        errno = EINVAL;
+        return RICE_ERROR;
+    }
+
+    writer = &stream->writer;
+    writer->sink.buffer = out;
+    writer->sink.next = out;
+    writer->sink.end = out + cap;
+
+    if (StreamEmit(stream) && (0 != writer->count))
+    {
+        /* pad fill with 1s so decode will run into the end */
+        pad = CHAR_BIT - writer->count;
+        writer->bits = (writer->bits << pad) | ((1 << pad) - 1);
+        writer->count += pad;
+        StreamEmit(stream);
+    }
+
+    return writer->sink.next - writer->sink.buffer;
+}
+
+/***************************************************************************
+*   Function   : RiceDecodeInit
+*   Description: This routine starts an incremental decoder for encoded
+*                data that arrives in pieces.  The stream is fed with
+*                RiceDecodeUpdate and ended with RiceDecodeFinish.  It
+*                decodes the output of RiceEncodeSamples, RiceEncodeFile,
+*                and RiceEncodeUpdate, no matter how it is split up.
+*   Parameters : options - pointer to k, limit, sample width, sample byte
+*                          order, and predictor.  They must match the
+*                          options used to encode the stream.  flags must
+*                          be 0.
+*   Effects    : Memory for the stream is allocated.
+*   Returned   : Pointer to the stream, or NULL for failure.  errno will
+*                be set in the event of a failure.  The stream must be
+*                freed with RiceStreamFree.
+***************************************************************************/
+rice_stream_t *RiceDecodeInit(const rice_options_t *options)
+{
+    rice_stream_t *stream;
+
+    stream = StreamNew(options, 0);
+
+    if (NULL == stream)
+    {
+        return NULL;
+    }
+
+    /* shortest codeword, adaptive k may be 0 */
+    stream->bound = (RICE_ADAPTIVE_K == options->k) ? 1 : (1 + options->k);
+
+    if ((NO_LIMIT != stream->reader.limit) &&
+        ((uint64_t)stream->reader.limit + stream->reader.width <
+        stream->bound))
+    {
+        stream->bound = stream->reader.limit + stream->reader.width;
+    }
+
+    return stream;
+}
+
+/***************************************************************************
+*   Function   : RiceDecodeUpdate
+*   Description: This routine decodes the next piece of a stream started
+*                by RiceDecodeInit.  While there's plenty of room in out,
+*                the decoders used by the file functions are given as much
+*                input as can't decode to more than fits, since even the
+*                shortest codewords will fit.  When out is nearly full or
+*                the input ends in the middle of a codeword, codewords are
+*                decoded one at a time.  The unary 1s and bits of an
+*                unfinished codeword are kept in the stream, and so is a
+*                decoded sample that doesn't fit in out.
+*   Parameters : stream - pointer to stream from RiceDecodeInit
+*                in - pointer to encoded bytes
+*                n - pointer to the number of bytes in in, set to the
+*                    number of bytes used.  Bytes are only left unused
+*                    when out is full.
+*                out - pointer to memory receiving decoded output
+*                cap - size of out in bytes
+*   Effects    : Input is decoded and the stream is updated.
+*   Returned   : The number of bytes written to out, or RICE_ERROR for
+*                failure.  errno will be set in the event of a failure
+*                (EILSEQ for a codeword wider than a sample).
+***************************************************************************/
+size_t RiceDecodeUpdate(rice_stream_t *stream, const uint8_t *in, size_t *n,
+    uint8_t *out, const size_t cap)
+{
+    bit_reader_t *reader;
+    byte_sink_t sink;
+    const unsigned char *end;           /* end of in */
+    uint64_t fit, slice;
+    uint32_t symbol;
+    unsigned char k;
+    int result;
+
+    if ((NULL == stream) || stream->encode || (NULL == n) ||
+        ((NULL == in) && (0 != *n)) || ((NULL == out) && (0 != cap)))
+    {
+        errno = EINVAL;
+        return RICE_ERROR;
+    }
+
+    reader = &stream->reader;
+    reader->next = in;
+    reader->end = in + *n;
+    end = reader->end;
+
+    sink.buffer = out;
+    sink.next = out;
+    sink.end = out + cap;
+    sink.fp = NULL;
+    sink.flushed = 0;
+
+    /* each pass starts with the last decoded sample written */
+    while (StreamPutSample(stream, &sink))
+    {
+        /* bits that can't decode to more samples than fit in out */
+        fit = (uint64_t)((sink.end - sink.next) / stream->size) *
+            stream->bound;
+
+        if ((0 == reader->unary) && (fit >= (reader->count + CHAR_BIT)))
+        {
+            slice = (fit - reader->count) / CHAR_BIT;
+
+            if (slice < (uint64_t)(end - reader->next))
+            {
+                reader->end = reader->next + slice;
+            }
+
+            if ((1 == stream->size) &&
+                (RICE_UNSIGNED == stream->options.predictor))
+            {
+                result = DecodeStream(reader, &sink, stream->options.k);
+            }
+            else
+            {
+                result = DecodeWords(reader, &sink, &stream->options,
+                    &stream->predictor);
+            }
+
+            if (0 != result)
+            {
+                return RICE_ERROR;
+            }
+
+            if (reader->end == end)
+            {
+                /* all of in has been decoded */
+                break;
+            }
+
+            reader->end = end;
+            continue;
+        }
+
+        /* out is nearly full or a codeword was cut off */
+        k = (RICE_ADAPTIVE_K == stream->options.k) ?
+            AdaptK(&reader->adapt) : stream->options.k;
+        result = DecodeSlow(reader, k, &symbol);
+
+        if (EOF == result)
+        {
+            break;
+        }
+        else if (0 != result)
+        {
+            return RICE_ERROR;
+        }
+
+        StreamStoreSymbol(stream, symbol);
+    }
+
+    *n = reader->next - in;
+    return sink.next - sink.buffer;
+}
+
+/***************************************************************************
+*   Function   : RiceDecodeFinish
+*   Description: This routine writes the end of a stream started by
+*                RiceDecodeInit and checks that the stream ended where the
+*                encoder ended it: after the last codeword there may only
+*                be fewer than 8 padding 1s.
+*   Parameters : stream - pointer to stream from RiceDecodeInit
+*                out - pointer to memory receiving decoded output
+*                cap - size of out in bytes
+*   Effects    : The rest of the decoded samples are written to out.  If
+*                they don't all fit, the rest is kept for the next call.
+*   Returned   : The number of bytes written to out, or RICE_ERROR for
+*                failure.  errno will be set in the event of a failure
+*                (EILSEQ if the stream was cut off).  The stream is
+*                finished when fewer than cap bytes are written.
+***************************************************************************/
+size_t RiceDecodeFinish(rice_stream_t *stream, uint8_t *out,
+    const size_t cap)
+{
+    bit_reader_t *reader;
+    size_t written, none;
+
+    /* decode what's left in the stream's window */
+    none = 0;
+    written = RiceDecodeUpdate(stream, NULL, &none, out, cap);
+
+    if ((RICE_ERROR == written) || (written == cap))
+    {
+        return written;
+    }
+
+    reader = &stream->reader;
+
+    if (((reader->unary + reader->count) >= CHAR_BIT) ||
+        ((0 != reader->count) &&
+        (0 != ((~reader->window) >> (WINDOW_BITS - reader->count)))))
+    {
+        /* more than padding is left */
+        errno = EILSEQ;
+        return RICE_ERROR;
+    }
+
+    return written;
+}
+
+/***************************************************************************
+*   Function   : RiceStreamFree
+*   Description: This routine frees a stream from RiceEncodeInit or
+*                RiceDecodeInit.
+*   Parameters : stream - pointer to stream, NULL is ignored
+*   Effects    : The stream's memory is freed.
+*   Returned   : None
+***************************************************************************/
+void RiceStreamFree(rice_stream_t *stream)
+{
+    free(stream);
+}
+
+/***************************************************************************
+*   Function   : CheckSampleOptions
+*   Description: This routine checks the options passed to the sample
+*                functions.
+*   Parameters : options - pointer to options
+*   Effects    : None
+*   Returned   : 0 if the options are usable, -1 if they aren't.  errno
+*                will be set to EINVAL if they aren't.
+***************************************************************************/
+static int CheckSampleOptions(const rice_options_t *options)
+{
+    if ((NULL == options) ||
+        ((options->k > MAX_WORD_K) && !((RICE_ADAPTIVE_K == options->k) &&
+        (1 == SAMPLE_BYTES(options->width)) &&
+        (RICE_UNSIGNED == options->predictor))) ||
+        (options->limit > RICE_MAX_LIMIT) ||
+        (0 != (options->width % CHAR_BIT)) ||
+        (options->width > MAX_WORD_BITS) ||
+        (options->order > RICE_LITTLE_ENDIAN) ||
+        (options->predictor > RICE_PREDICT_3) ||
+        (0 != (options->flags & ~RICE_FLAG_HEADER)))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : PutHeader
+*   Description: This routine builds the header that starts a sample
+*                stream encoded with RICE_FLAG_HEADER:
+*
+*                magic      4 bytes, HEADER_MAGIC
+*                version    1 byte, HEADER_VERSION
+*                k          1 byte, k or RICE_ADAPTIVE_K
+*                limit      1 byte, unary length of an escape, 0 for none
+*                width      1 byte, bits per sample
+*                order      1 byte, sample byte order
+*                predictor  1 byte, RICE_UNSIGNED or RICE_PREDICT_n
+*                flags      1 byte, HEADER_LENGTH_KNOWN
+*                unused     1 byte, 0
+*                length     8 bytes, big endian, unencoded bytes
+*
+*   Parameters : header - pointer to HEADER_SIZE bytes receiving the header
+*                options - pointer to the options the stream is encoded with
+*                length - number of unencoded bytes
+*                known - non-zero if length is known
+*   Effects    : header is filled in.
+*   Returned   : None
+***************************************************************************/
+static void PutHeader(unsigned char *header, const rice_options_t *options,
+    const uint64_t length, const int known)
+{
+    unsigned int i;
+
+    memcpy(header, HEADER_MAGIC, 4);
+    header[4] = HEADER_VERSION;
+    header[5] = options->k;
+    header[6] = (unsigned char)options->limit;
+    header[7] = (unsigned char)(SAMPLE_BYTES(options->width) * CHAR_BIT);
+    header[8] = options->order;
+    header[9] = options->predictor;
+    header[HEADER_FLAGS] = known ? HEADER_LENGTH_KNOWN : 0;
+    header[HEADER_FLAGS + 1] = 0;
+
+    for (i = 0; i < 8; i++)
+    {
+        header[HEADER_FLAGS + 2 + i] = (unsigned char)(length >> (56 - (8 * i)));
+    }
+}
+
+/***************************************************************************
+*   Function   : PatchHeaderLength
+*   Description: This routine fills in the unencoded length of a sample
+*                header that was written before the length was known.
+*                Files that can't seek, like pipes, keep a header without
+*                a length.
+*   Parameters : fp - pointer to open file with the header
+*                header - position of the header in fp
+*                length - number of unencoded bytes
+*   Effects    : The header's flags and length are rewritten and fp is
+*                returned to its end.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int PatchHeaderLength(FILE *fp, const off_t header,
+    const uint64_t length)
+{
+    unsigned char patch[HEADER_SIZE];
+    rice_options_t options;
+    off_t end;
+
+    end = ftello(fp);
+
+    if ((-1 == end) || (0 != fseeko(fp, header + HEADER_FLAGS, SEEK_SET)))
+    {
+        /* can't seek, the length stays unknown */
+        clearerr(fp);
+        return 0;
+    }
+
+    memset(&options, 0, sizeof(options));
+    PutHeader(patch, &options, length, 1);
+
+    if (((HEADER_SIZE - HEADER_FLAGS) != fwrite(patch + HEADER_FLAGS, 1,
+        HEADER_SIZE - HEADER_FLAGS, fp)) ||
+        (0 != fseeko(fp, end, SEEK_SET)))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : ReadHeader
+*   Description: This routine reads and checks the header that starts a
+*                sample stream encoded with RICE_FLAG_HEADER (see
+*                PutHeader).  Unknown versions and bad options are
+*                rejected before anything is decoded.
+*   Parameters : fp - pointer to open file being decoded
+*                options - pointer to options receiving the stream's k,
+*                          limit, width, order, and predictor
+*                length - pointer to where the unencoded length is stored
+*                known - pointer to where non-zero is stored if the length
+*                        is known
+*   Effects    : The header is read from fp.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure (EILSEQ if there isn't a valid header).
+***************************************************************************/
+static int ReadHeader(FILE *fp, rice_options_t *options, uint64_t *length,
+    int *known)
+{
+    unsigned char header[HEADER_SIZE];
+    unsigned int i;
+
+    if (HEADER_SIZE != fread(header, 1, HEADER_SIZE, fp))
+    {
+        if (!ferror(fp))
+        {
+            errno = EILSEQ;
+        }
+
+        return -1;
+    }
+
+    memset(options, 0, sizeof(*options));
+    options->k = header[5];
+    options->limit = header[6];
+    options->width = header[7];
+    options->order = header[8];
+    options->predictor = header[9];
+    *known = header[HEADER_FLAGS] & HEADER_LENGTH_KNOWN;
+    *length = 0;
+
+    for (i = 0; i < 8; i++)
+    {
+        *length = (*length << 8) | header[HEADER_FLAGS + 2 + i];
+    }
+
+    if ((0 != memcmp(header, HEADER_MAGIC, 4)) ||
+        (HEADER_VERSION != header[4]) || (0 == options->width) ||
+        (0 != (header[HEADER_FLAGS] & ~HEADER_LENGTH_KNOWN)) ||
+        (0 != CheckSampleOptions(options)) ||
+        (0 != (*length % SAMPLE_BYTES(options->width))))
+    {
+        errno = EILSEQ;
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : PreallocateOutput
+*   Description: This routine sets the size of a regular output file to
+*                the size it will have once length more bytes are written
+*                at its current position, so the file system can allocate
+*                it up front.
+*   Parameters : fp - pointer to open file receiving decoded output
+*                length - number of bytes that will be written
+*   Effects    : The file's size may be changed.  Failures only lose the
+*                preallocation, so they are ignored.
+*   Returned   : The position the output starts at if the file was
+*                extended, otherwise -1.
+***************************************************************************/
+static off_t PreallocateOutput(FILE *fp, const uint64_t length)
+{
+    struct stat status;
+    off_t start;
+
+    start = ftello(fp);
+
+    if ((-1 == start) || (0 != fflush(fp)) ||
+        (0 != fstat(fileno(fp), &status)) || !S_ISREG(status.st_mode))
+    {
+        return -1;
+    }
+
+    if (0 != ftruncate(fileno(fp), start + (off_t)length))
+    {
+        /* the decoded bytes will still extend the file */
+        return -1;
+    }
+
+    return start;
+}
+
+/***************************************************************************
+*   Function   : PredictorInit
+*   Description: This routine sets up a fixed predictor with a history of
+*                0 samples.
+*   Parameters : predictor - pointer to predictor
+*                mode - RICE_UNSIGNED or RICE_PREDICT_0 to RICE_PREDICT_3
+*   Effects    : predictor is initialized.
+*   Returned   : None
+***************************************************************************/
+static void PredictorInit(predictor_t *predictor, const unsigned char mode)
+{
+    predictor->order = (RICE_UNSIGNED == mode) ? 0 : (mode - RICE_PREDICT_0);
+    memset(predictor->last, 0, sizeof(predictor->last));
+}
+
+/***************************************************************************
+*   Function   : StreamNew
+*   Description: This routine allocates and sets up the parts of an
+*                incremental encoder or decoder that they share.
+*   Parameters : options - pointer to k, limit, sample width, sample byte
+*                          order, and predictor
+*                encode - non-zero for an encoder
+*   Effects    : Memory for the stream is allocated.
+*   Returned   : Pointer to the stream, or NULL for failure.  errno will
+*                be set in the event of a failure.
+***************************************************************************/
+static rice_stream_t *StreamNew(const rice_options_t *options,
+    const char encode)
+{
+    rice_stream_t *stream;
+
+    if (0 != CheckSampleOptions(options))
+    {
+        return NULL;
+    }
+
+    if (0 != options->flags)
+    {
+        /* the stream functions don't write or read headers */
+        errno = EINVAL;
+        return NULL;
+    }
+
+    stream = (rice_stream_t *)malloc(sizeof(rice_stream_t));
+
+    if (NULL == stream)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    memset(stream, 0, sizeof(rice_stream_t));
+    stream->options = *options;
+    stream->encode = encode;
+    stream->size = SAMPLE_BYTES(options->width);
+    stream->options.width = (unsigned char)(stream->size * CHAR_BIT);
+
+    stream->writer.limit = UNARY_LIMIT(options->limit);
+    stream->writer.width = stream->size * CHAR_BIT;
+    stream->writer.sink.fp = NULL;
+    AdaptInit(&stream->writer.adapt);
+
+    stream->reader.fp = NULL;
+    stream->reader.limit = UNARY_LIMIT(options->limit);
+    stream->reader.width = stream->size * CHAR_BIT;
+    AdaptInit(&stream->reader.adapt);
+
+    PredictorInit(&stream->predictor, options->predictor);
+    return stream;
+}
+
+/***************************************************************************
+*   Function   : StreamEmit
+*   Description: This routine writes as much of an incremental encoder's
+*                unfinished codeword as fits in its writer's sink.  The
+*                unary 1s are added to the accumulator ENCODE_CHUNK at a
+*                time, so a codeword of any length only needs the
+*                accumulator.
+*   Parameters : stream - pointer to encoder stream
+*   Effects    : Whole bytes are written to the sink and removed from the
+*                stream.
+*   Returned   : 1 if fewer than 8 bits are left, 0 if the sink filled up
+*                first.
+***************************************************************************/
+static int StreamEmit(rice_stream_t *stream)
+{
+    bit_writer_t *writer;
+    unsigned int run;
+
+    writer = &stream->writer;
+
+    while (1)
+    {
+        while (writer->count >= 8)
+        {
+            if (writer->sink.next == writer->sink.end)
+            {
+                return 0;
+            }
+
+            writer->count -= 8;
+            *(writer->sink.next) =
+                (unsigned char)(writer->bits >> writer->count);
+            writer->sink.next++;
+        }
+
+        if (0 != stream->unary)
+        {
+            run = (stream->unary < ENCODE_CHUNK) ?
+                (unsigned int)stream->unary : ENCODE_CHUNK;
+            writer->bits = (writer->bits << run) |
+                ((((uint64_t)1) << run) - 1);
+            writer->count += run;
+            stream->unary -= run;
+        }
+        else if (0 != stream->tailLength)
+        {
+            writer->bits = (writer->bits << stream->tailLength) |
+                stream->tail;
+            writer->count += stream->tailLength;
+            stream->tailLength = 0;
+        }
+        else
+        {
+            return 1;
+        }
+    }
+}
+
+/***************************************************************************
+*   Function   : StreamEncodeSample
+*   Description: This routine makes a sample the unfinished codeword of an
+*                incremental encoder, so StreamEmit can write it a piece at
+*                a time.  The codeword is the same one EncodeSlow writes.
+*   Parameters : stream - pointer to encoder stream without an unfinished
+*                         codeword
+*                bytes - pointer to the sample's bytes
+*   Effects    : The stream's codeword, predictor history, and adaptive
+*                statistics are updated.
+*   Returned   : None
+***************************************************************************/
+static void StreamEncodeSample(rice_stream_t *stream,
+    const unsigned char *bytes)
+{
+    uint32_t samples[MAX_ORDER + 1];    /* history, then the sample */
+    uint32_t symbol;
+    unsigned char k;
+
+    memcpy(samples, stream->predictor.last, sizeof(stream->predictor.last));
+    LoadSamples(bytes, 1, stream->size, stream->options.order,
+        samples + MAX_ORDER);
+    symbol = samples[MAX_ORDER];
+
+    if (RICE_UNSIGNED != stream->options.predictor)
+    {
+        PredictResiduals(samples + MAX_ORDER, 1, stream->predictor.order,
+            stream->writer.width, &symbol);
+        memcpy(stream->predictor.last, samples + 1,
+            sizeof(stream->predictor.last));
+    }
+
+    k = stream->options.k;
+
+    if (RICE_ADAPTIVE_K == k)
+    {
+        k = AdaptK(&stream->writer.adapt);
+        AdaptUpdate(&stream->writer.adapt, (unsigned char)symbol);
+    }
+
+    stream->unary = symbol >> k;
+
+    if (stream->unary >= stream->writer.limit)
+    {
+        /* no ending 0 after the limit's 1s, then the whole symbol */
+        stream->unary = stream->writer.limit;
+        stream->tail = symbol;
+        stream->tailLength = stream->writer.width;
+    }
+    else
+    {
+        /* an ending 0, then the binary portion */
+        stream->tail = (uint32_t)(symbol & ((((uint64_t)1) << k) - 1));
+        stream->tailLength = 1 + k;
+    }
+}
+
+/***************************************************************************
+*   Function   : StreamPutSample
+*   Description: This routine writes as much of an incremental decoder's
+*                last decoded sample as fits in a byte sink.
+*   Parameters : stream - pointer to decoder stream
+*                sink - pointer to memory byte sink
+*   Effects    : Bytes of the sample are written to the sink.
+*   Returned   : 1 if the whole sample has been written, 0 if the sink
+*                filled up first.
+***************************************************************************/
+static int StreamPutSample(rice_stream_t *stream, byte_sink_t *sink)
+{
+    while (stream->next < stream->have)
+    {
+        if (sink->next == sink->end)
+        {
+            return 0;
+        }
+
+        *(sink->next) = stream->sample[stream->next];
+        sink->next++;
+        stream->next++;
+    }
+
+    return 1;
+}
+
+/***************************************************************************
+*   Function   : StreamStoreSymbol
+*   Description: This routine turns a symbol decoded by an incremental
+*                decoder into a sample the way DecodeStream and
+*                DecodeWords do, and keeps it for StreamPutSample.
+*   Parameters : stream - pointer to decoder stream
+*                symbol - decoded symbol
+*   Effects    : The stream's sample, predictor history, and adaptive
+*                statistics are updated.
+*   Returned   : None
+***************************************************************************/
+static void StreamStoreSymbol(rice_stream_t *stream, uint32_t symbol)
+{
+    uint32_t mask;
+
+    mask = (uint32_t)((((uint64_t)1) << stream->reader.width) - 1);
+
+    if (RICE_ADAPTIVE_K == stream->options.k)
+    {
+        AdaptUpdate(&stream->reader.adapt, (unsigned char)symbol);
+    }
+
+    if (RICE_UNSIGNED != stream->options.predictor)
+    {
+        symbol = PredictSample(&stream->predictor, UNZIGZAG(symbol, mask),
+            mask);
+    }
+
+    StoreSample(stream->sample, symbol, stream->size, stream->options.order);
+    stream->have = stream->size;
+    stream->next = 0;
+}
+
+/***************************************************************************
+*   Function   : RiceBestK
+*   Description: This routine finds the k that encodes a buffer of bytes
+*                in the fewest bits.  The bytes are counted once, then the
+*                encoded size for each k is computed from the counts: a
+*                symbol c costs (c >> k) + 1 + k bits, so n symbols cost
+*                n * (1 + k) bits plus the sum of count[c] * (c >> k).
+*   Parameters : in - pointer to bytes to be encoded
+*                n - number of bytes to be encoded
+*   Effects    : None
+*   Returned   : The k from 0 to AUTO_MAX_K giving the smallest encoded
+*                size.  Ties go to the smaller k.
+***************************************************************************/
+unsigned char RiceBestK(const uint8_t *in, const size_t n)
+{
+    size_t histogram[ENCODE_SYMBOLS];
+    uint64_t bits, bestBits;
+    unsigned int symbol;
+    unsigned char k, bestK;
+
+    CountSymbols(in, n, histogram);
+    bestK = 0;
+    bestBits = 0;
+
+    for (k = 0; k <= AUTO_MAX_K; k++)
+    {
+        bits = (uint64_t)n * (1 + k);
+
+        for (symbol = (1 << k); symbol < ENCODE_SYMBOLS; symbol++)
+        {
+            bits += (uint64_t)histogram[symbol] * (symbol >> k);
+        }
+
+        if ((0 == k) || (bits < bestBits))
+        {
+            bestK = k;
+            bestBits = bits;
+        }
+    }
+
+    return bestK;
+}
+
+/***************************************************************************
+*   Function   : CountSymbols
+*   Description: This routine counts how many times each byte value
+*                appears in a buffer.  Consecutive bytes are counted in
+*                HISTOGRAMS separate histograms that are summed at the end,
+*                so runs of the same value don't wait on each other's
+*                increments.
+*   Parameters : bytes - pointer to bytes to count
+*                count - number of bytes to count
+*                histogram - pointer to ENCODE_SYMBOLS counts
+*   Effects    : histogram[c] is set to the number of bytes equal to c.
+*   Returned   : None
+***************************************************************************/
+static void CountSymbols(const unsigned char *bytes, const size_t count,
+    size_t *histogram)
+{
+    size_t counts[HISTOGRAMS][ENCODE_SYMBOLS];
+    size_t i;
+    unsigned int symbol;
+
+    memset(counts, 0, sizeof(counts));
+
+    for (i = 0; (i + HISTOGRAMS) <= count; i += HISTOGRAMS)
+    {
+        counts[0][bytes[i]]++;
+        counts[1][bytes[i + 1]]++;
+        counts[2][bytes[i + 2]]++;
+        counts[3][bytes[i + 3]]++;
+    }
+
+    for (; i < count; i++)
+    {
+        counts[0][bytes[i]]++;
+    }
+
+    for (symbol = 0; symbol < ENCODE_SYMBOLS; symbol++)
+    {
+        histogram[symbol] = counts[0][symbol] + counts[1][symbol] +
+            counts[2][symbol] + counts[3][symbol];
+    }
+}
+
+/***************************************************************************
+*   Function   : GetEncodeTable
+*   Description: This routine returns the encode table for codes with a k
+*                bit binary portion, building it the first time it is
+*                requested.  The table holds the right justified codeword
+*                and its length for every byte value.
+*   Parameters : k - length of binary portion of encoded word
+*   Effects    : The encode table for k is built if it hasn't been.
+*   Returned   : Pointer to the encode table for k, NULL if k doesn't have
+*                a table.
+***************************************************************************/
+static const encode_entry_t *GetEncodeTable(const unsigned char k)
+{
+    encode_entry_t *table;
+    unsigned int symbol, unary;
+
+    if (k > TABLE_MAX_K)
+    {
+        return NULL;
+    }
+
+    table = encodeTable[k - ENCODE_MIN_K];
+
+    if (encodeTableReady[k - ENCODE_MIN_K])
+    {
+        return table;
+    }
+
+    for (symbol = 0; symbol < ENCODE_SYMBOLS; symbol++)
+    {
+        unary = symbol >> k;
+        table[symbol].length = unary + 1 + k;
+
+        if (table[symbol].length <= ENCODE_BITS)
+        {
+            /* unary 1s, an ending 0, then the binary portion */
+            table[symbol].code = (((uint64_t)1 << unary) - 1) << (1 + k);
+            table[symbol].code |= symbol & ((1 << k) - 1);
+        }
+        else
+        {
+            /* too long to append at once, EncodeSlow will handle it */
+            table[symbol].code = 0;
+        }
+    }
+
+    encodeTableReady[k - ENCODE_MIN_K] = 1;
+    return table;
+}
+
+/***************************************************************************
+*   Function   : WriterDrain
+*   Description: This routine moves all of the whole bytes in a bit
+*                writer's accumulator to its byte sink.
+*   Parameters : writer - pointer to bit writer
+*   Effects    : Fewer than 8 bits are left in the accumulator.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int WriterDrain(bit_writer_t *writer)
+{
+    while (writer->count >= 8)
+    {
+        if (writer->sink.next == writer->sink.end)
+        {
+            if (0 != SinkFlush(&writer->sink))
+            {
+                return -1;
+            }
+
+            if (writer->sink.next == writer->sink.end)
+            {
+                /* memory sink is full */
+                errno = ENOBUFS;
+                return -1;
+            }
+        }
+
+        writer->count -= 8;
+        *(writer->sink.next) = (unsigned char)(writer->bits >> writer->count);
+        writer->sink.next++;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : EncodeSlow
+*   Description: This routine writes the codeword for a single symbol
+*                without using an encode table.  Unary runs are written
+*                ENCODE_CHUNK bits at a time, so codewords longer than the
+*                accumulator are handled.  Symbols with a unary portion of
+*                at least the writer's limit are written as an escape.
+*   Parameters : writer - pointer to bit writer
+*                k - length of binary portion of encoded word
+*                symbol - symbol to encode (writer->width bits)
+*   Effects    : The codeword for symbol is written to the bit writer.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int EncodeSlow(bit_writer_t *writer, const unsigned char k,
+    const uint32_t symbol)
+{
+    uint32_t unary;
+    unsigned int tail;
+    int escape;
+
+    unary = (k <= MAX_WORD_K) ? (symbol >> k) : 0;
+    escape = (unary >= writer->limit);
+
+    if (escape)
+    {
+        unary = writer->limit;
+    }
+
+    while (unary >= ENCODE_CHUNK)
+    {
+        if (0 != WriterDrain(writer))
+        {
+            return -1;
+        }
+
+        writer->bits = (writer->bits << ENCODE_CHUNK) |
+            ((((uint64_t)1) << ENCODE_CHUNK) - 1);
+        writer->count += ENCODE_CHUNK;
+        unary -= ENCODE_CHUNK;
+    }
+
+    if (0 != WriterDrain(writer))
+    {
+        return -1;
+    }
+
+    /* remaining 1s */
+    writer->bits = (writer->bits << unary) | ((((uint64_t)1) << unary) - 1);
+    writer->count += unary;
+    tail = escape ? writer->width : (unsigned int)(1 + k);
+
+    if ((writer->count + tail) > WINDOW_BITS)
+    {
+        if (0 != WriterDrain(writer))
+        {
+            return -1;
+        }
+    }
+
+    if (escape)
+    {
+        /* no ending 0 after the limit's 1s, then the whole symbol */
+        writer->bits = (writer->bits << tail) | symbol;
+        writer->count += tail;
+        return 0;
+    }
+
+    /* an ending 0, then the binary portion */
+    writer->bits = (writer->bits << tail) |
+        (symbol & ((((uint64_t)1) << k) - 1));
+    writer->count += tail;
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : EncodeBytes
+*   Description: This routine writes the codewords for a buffer of
+*                symbols to a bit writer.
+*   Parameters : writer - pointer to bit writer
+*                bytes - symbols to encode
+*                count - number of symbols to encode
+*                k - length of binary portion of encoded word
+*   Effects    : The codewords for the symbols are written to the bit
+*                writer.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int EncodeBytes(bit_writer_t *writer, const unsigned char *bytes,
+    const size_t count, const unsigned char k)
+{
+    const encode_entry_t *table;
+    const encode_entry_t *entry;
+    size_t i, written;
+    unsigned int maxLength;
+
+    if (RICE_ADAPTIVE_K == k)
+    {
+        return EncodeAdaptive(writer, bytes, count);
+    }
+
+    table = GetEncodeTable(k);
+
+    if (NULL == table)
+    {
+        /* no table for this k */
+        for (i = 0; i < count; i++)
+        {
+            if (0 != EncodeSlow(writer, k, bytes[i]))
+            {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    if (-1 == useAvx2)
+    {
+        useAvx2 = RiceHaveAvx2();
+    }
+
+    /* codewords up to limit + k bits long aren't escapes */
+    maxLength = (writer->limit < (unsigned int)(AVX2_MAX_CODEWORD - k)) ?
+        (writer->limit + k) : AVX2_MAX_CODEWORD;
+    i = 0;
+
+    while (i < count)
+    {
+        if (useAvx2 && ((count - i) >= AVX2_SYMBOLS))
+        {
+            if (0 != WriterDrain(writer))
+            {
+                return -1;
+            }
+
+            if ((writer->sink.end - writer->sink.next) < AVX2_OUT_BYTES)
+            {
+                if (0 != SinkFlush(&writer->sink))
+                {
+                    return -1;
+                }
+            }
+
+            if ((writer->sink.end - writer->sink.next) >= AVX2_OUT_BYTES)
+            {
+                written = RiceEncodeAvx2(bytes + i, k, maxLength,
+                    &writer->bits, &writer->count, writer->sink.next);
+
+                if (AVX2_TOO_LONG != written)
+                {
+                    writer->sink.next += written;
+                    i += AVX2_SYMBOLS;
+                    continue;
+                }
+            }
+        }
+
+        /* no kernel, too little room, or a long codeword in the block */
+        entry = &table[bytes[i]];
+
+        if ((entry->length > ENCODE_BITS) ||
+            ((unsigned int)(bytes[i] >> k) >= writer->limit))
+        {
+            if (0 != EncodeSlow(writer, k, bytes[i]))
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            if ((writer->count + entry->length) > WINDOW_BITS)
+            {
+                if (0 != WriterDrain(writer))
+                {
+                    return -1;
+                }
+            }
+
+            writer->bits = (writer->bits << entry->length) | entry->code;
+            writer->count += entry->length;
+        }
+
+        i++;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : EncodeAdaptive
+*   Description: This routine writes the codewords for a buffer of
+*                symbols to a bit writer, picking k for each symbol from
+*                the symbols before it (see AdaptK).  The codeword is
+*                looked up in the encode table for that k.
+*   Parameters : writer - pointer to bit writer
+*                bytes - symbols to encode
+*                count - number of symbols to encode
+*   Effects    : The codewords for the symbols are written to the bit
+*                writer and its adaptive statistics are updated.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int EncodeAdaptive(bit_writer_t *writer, const unsigned char *bytes,
+    const size_t count)
+{
+    const encode_entry_t *tables[ADAPT_MAX_K + 1];
+    const encode_entry_t *entry;
+    unsigned char k;
+    size_t i;
+
+    for (k = 0; k <= ADAPT_MAX_K; k++)
+    {
+        tables[k] = GetEncodeTable(k);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        k = AdaptK(&writer->adapt);
+        entry = &tables[k][bytes[i]];
+
+        if ((entry->length > ENCODE_BITS) ||
+            ((unsigned int)(bytes[i] >> k) >= writer->limit))
+        {
+            if (0 != EncodeSlow(writer, k, bytes[i]))
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            if ((writer->count + entry->length) > WINDOW_BITS)
+            {
+                if (0 != WriterDrain(writer))
+                {
+                    return -1;
+                }
+            }
+
+            writer->bits = (writer->bits << entry->length) | entry->code;
+            writer->count += entry->length;
+        }
+
+        AdaptUpdate(&writer->adapt, bytes[i]);
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : EncodeWords
+*   Description: This routine writes the codewords for a buffer of 8 to
+*                32 bit samples to a bit writer.  Samples are loaded and,
+*                for signed samples, turned into zigzagged prediction
+*                residuals WORD_CHUNK at a time in loops without branches
+*                or carried values, so they may be vectorized.  Each chunk
+*                is then coded while it is still in cache.  Codewords that
+*                fit in the accumulator are built in place: unary 1s, an
+*                ending 0, and the k low bits of the symbol.  Longer
+*                codewords and escapes go through EncodeSlow.
+*   Parameters : writer - pointer to bit writer (width is the sample size)
+*                bytes - samples to encode
+*                count - number of samples to encode
+*                options - pointer to k, byte order, and predictor
+*                predictor - pointer to the predictor's sample history
+*   Effects    : The codewords for the samples are written to the bit
+*                writer and the predictor history is updated.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int EncodeWords(bit_writer_t *writer, const unsigned char *bytes,
+    const size_t count, const rice_options_t *options,
+    predictor_t *predictor)
+{
+    uint32_t samples[MAX_ORDER + WORD_CHUNK];   /* history, then chunk */
+    uint32_t residuals[WORD_CHUNK];
+    const uint32_t *symbols;
+    uint64_t binaryMask;
+    uint32_t unary;
+    unsigned int size, length, chunk, j;
+    unsigned char k;
+    size_t i;
+
+    k = options->k;
+    size = writer->width / CHAR_BIT;
+    binaryMask = (((uint64_t)1) << k) - 1;
+    memcpy(samples, predictor->last, sizeof(predictor->last));
+
+    for (i = 0; i < count; i += chunk)
+    {
+        chunk = ((count - i) < WORD_CHUNK) ? (unsigned int)(count - i) :
+            WORD_CHUNK;
+        LoadSamples(bytes + (i * size), chunk, size, options->order,
+            samples + MAX_ORDER);
+
+        if (RICE_UNSIGNED == options->predictor)
+        {
+            symbols = samples + MAX_ORDER;
+        }
+        else
+        {
+            PredictResiduals(samples + MAX_ORDER, chunk, predictor->order,
+                writer->width, residuals);
+            symbols = residuals;
+
+            /* the end of this chunk is the history for the next one */
+            memmove(samples, samples + chunk, sizeof(predictor->last));
+        }
+
+        for (j = 0; j < chunk; j++)
+        {
+            unary = symbols[j] >> k;
+
+            if ((unary >= writer->limit) ||
+                (unary > (unsigned int)(ENCODE_BITS - 1 - k)))
+            {
+                if (0 != EncodeSlow(writer, k, symbols[j]))
+                {
+                    return -1;
+                }
+
+                continue;
+            }
+
+            length = unary + 1 + k;
+
+            if ((writer->count + length) > WINDOW_BITS)
+            {
+                if (0 != WriterDrain(writer))
+                {
+                    return -1;
+                }
+            }
+
+            /* unary 1s, an ending 0, then the binary portion */
+            writer->bits = (writer->bits << length) |
+                (((((uint64_t)1) << unary) - 1) << (1 + k)) |
+                (symbols[j] & binaryMask);
+            writer->count += length;
+        }
+    }
+
+    memcpy(predictor->last, samples, sizeof(predictor->last));
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : LoadSamples
+*   Description: This routine converts samples stored as bytes in either
+*                byte order to 32 bit words.
+*   Parameters : bytes - samples to load
+*                count - number of samples to load
+*                size - bytes in each sample
+*                order - byte order of the samples
+*                samples - pointer to count words receiving the samples
+*   Effects    : samples is filled in.
+*   Returned   : None
+***************************************************************************/
+static void LoadSamples(const unsigned char *bytes, const unsigned int count,
+    const unsigned int size, const unsigned char order, uint32_t *samples)
+{
+    unsigned int i, j;
+    uint32_t sample;
+
+    for (i = 0; i < count; i++, bytes += size)
+    {
+        sample = 0;
+
+        if (RICE_BIG_ENDIAN == order)
+        {
+            for (j = 0; j < size; j++)
+            {
+                sample = (sample << CHAR_BIT) | bytes[j];
+            }
+        }
+        else
+        {
+            for (j = size; j > 0; j--)
+            {
+                sample = (sample << CHAR_BIT) | bytes[j - 1];
+            }
+        }
+
+        samples[i] = sample;
+    }
+}
+
+/***************************************************************************
+*   Function   : PredictResiduals
+*   Description: This routine computes the zigzagged residuals of a fixed
+*                (FLAC style) predictor for a chunk of width bit signed
+*                samples.  The residuals are computed modulo 2^width, so
+*                they are width bits wide no matter how far off the
+*                prediction is, and the decoder undoes them exactly.  Each
+*                order has its own loop, and every residual depends only
+*                on the samples, so the loops may be vectorized.
+*   Parameters : samples - pointer to count samples, preceded by the
+*                          MAX_ORDER samples before them
+*                count - number of samples
+*                order - predictor order (0 - MAX_ORDER)
+*                width - bits in a sample
+*                residuals - pointer to count words receiving the residuals
+*   Effects    : residuals is filled in.
+*   Returned   : None
+***************************************************************************/
+static void PredictResiduals(const uint32_t *samples,
+    const unsigned int count, const unsigned int order,
+    const unsigned int width, uint32_t *residuals)
+{
+    const uint32_t *last1, *last2, *last3;  /* samples 1 to 3 back */
+    uint32_t mask, top, residual;
+    unsigned int i;
+
+    mask = (uint32_t)((((uint64_t)1) << width) - 1);
+    top = width - 1;
+    last1 = samples - 1;
+    last2 = samples - 2;
+    last3 = samples - 3;
+
+    switch (order)
+    {
+        case 0:
+            for (i = 0; i < count; i++)
+            {
+                residual = samples[i] & mask;
+                residuals[i] = ZIGZAG(residual, top, mask);
+            }
+            break;
+
+        case 1:
+            for (i = 0; i < count; i++)
+            {
+                residual = (samples[i] - last1[i]) & mask;
+                residuals[i] = ZIGZAG(residual, top, mask);
+            }
+            break;
+
+        case 2:
+            for (i = 0; i < count; i++)
+            {
+                residual = (samples[i] - (2 * last1[i]) + last2[i]) & mask;
+                residuals[i] = ZIGZAG(residual, top, mask);
+            }
+            break;
+
+        default:
+            for (i = 0; i < count; i++)
+            {
+                residual = (samples[i] - (3 * last1[i]) + (3 * last2[i]) -
+                    last3[i]) & mask;
+                residuals[i] = ZIGZAG(residual, top, mask);
+            }
+            break;
+    }
+}
+
+/***************************************************************************
+*   Function   : WriterFlush
+*   Description: This routine pads the bits in a bit writer to a whole
+*                byte with 1s and writes everything to its sink's file.
+*                Padding with 1s lets the decoder run into the end of the
+*                stream while it's still counting unary 1s.
+*   Parameters : writer - pointer to bit writer
+*   Effects    : All bits are written out and the bit writer is emptied.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int WriterFlush(bit_writer_t *writer)
+{
+    unsigned int pad;
+
+    pad = (8 - (writer->count % 8)) % 8;
+    writer->bits = (writer->bits << pad) | ((1 << pad) - 1);
+    writer->count += pad;
+
+    if (0 != WriterDrain(writer))
+    {
+        return -1;
+    }
+
+    return SinkFlush(&writer->sink);
+}
+
+/***************************************************************************
+*   Function   : RiceDecodeFile
+*   Description: This routine reads a rice encoded input file and writes
+*                the decoded output.  Codewords are decoded using lookup
+*                tables that return every complete codeword in a window of
+*                encoded bits.
+*   Parameters : inFile - pointer to open file to decode
+*                outFile - pointer to open file receiving decoded output
+*                k - length of binary portion of encoded word
+*   Effects    : File is decoded using the Rice algorithm for codes with a
+*                k bit binary portion.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.  Either way, inFile and outFile will
+*                be left open.
+***************************************************************************/
+int RiceDecodeFile(FILE *inFile, FILE *outFile, const unsigned char k)
+{
+    bit_reader_t reader;                /* encoded input */
+    byte_sink_t sink;                   /* decoded output */
+    int result;
+
+    /* validate input and output files */
+    if ((NULL == inFile) || (NULL == outFile))
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    reader.buffer = (unsigned char *)malloc(IO_BUFFER_SIZE);
+    sink.buffer = (unsigned char *)malloc(IO_BUFFER_SIZE);
+
+    if ((NULL == reader.buffer) || (NULL == sink.buffer))
+    {
+        perror("Allocating Decode Buffers");
+        free(reader.buffer);
+        free(sink.buffer);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    reader.window = 0;
+    reader.count = 0;
+    reader.next = reader.buffer;
+    reader.end = reader.buffer;
+    reader.bufferSize = IO_BUFFER_SIZE;
+    reader.fp = inFile;
+    reader.limit = NO_LIMIT;
+    reader.width = CHAR_BIT;
+    AdaptInit(&reader.adapt);
+    reader.unary = 0;
+
+    sink.next = sink.buffer;
+    sink.end = sink.buffer + IO_BUFFER_SIZE;
+    sink.fp = outFile;
+    sink.flushed = 0;
+
+    result = DecodeStream(&reader, &sink, k);
+
+    if (0 == result)
+    {
+        result = SinkFlush(&sink);
+    }
+
+    free(reader.buffer);
+    free(sink.buffer);
+    return result;
+}
+
+/***************************************************************************
+*   Function   : GetDecodeTable
+*   Description: This routine returns the decode table for codes with a k
+*                bit binary portion, building it the first time it is
+*                requested.  Each entry is indexed by a DECODE_BITS wide
+*                window of encoded bits (msb first) and holds every complete
+*                codeword in that window.  Entries for windows starting
+*                with an unary run that doesn't fit or doesn't decode to a
+*                byte have a count of 0.
+*   Parameters : k - length of binary portion of encoded word
+*   Effects    : The decode table for k is built if it hasn't been.
+*   Returned   : Pointer to the decode table for k, NULL if k doesn't have
+*                a table.
+***************************************************************************/
+static const decode_entry_t *GetDecodeTable(const unsigned char k)
+{
+    decode_entry_t *table;
+    unsigned int window, pos, bit, unary, binary;
+
+    if ((k < TABLE_MIN_K) || (k > TABLE_MAX_K))
+    {
+        return NULL;
+    }
+
+    table = decodeTable[k - TABLE_MIN_K];
+
+    if (decodeTableReady[k - TABLE_MIN_K])
+    {
+        return table;
+    }
+
+    for (window = 0; window < (1 << DECODE_BITS); window++)
+    {
+        table[window].count = 0;
+        pos = 0;
+
+        while (1)
+        {
+            /* count the 1s in the unary portion */
+            unary = 0;
+            bit = pos;
+
+            while ((bit < DECODE_BITS) &&
+                ((window >> (DECODE_BITS - 1 - bit)) & 0x01))
+            {
+                unary++;
+                bit++;
+            }
+
+            if ((bit + 1 + k > DECODE_BITS) || (unary > MAX_UNARY(k)))
+            {
+                /* the rest of the codeword isn't in the window */
+                break;
+            }
+
+            /* skip the ending 0 and extract the binary portion */
+            bit += 1 + k;
+            binary = (window >> (DECODE_BITS - bit)) & ((1 << k) - 1);
+
+            table[window].symbols[table[window].count] =
+                (unsigned char)((unary << k) | binary);
+            table[window].count++;
+            pos = bit;
+        }
+
+        table[window].bits = (unsigned char)pos;
+    }
+
+    decodeTableReady[k - TABLE_MIN_K] = 1;
+    return table;
+}
+
+/***************************************************************************
+*   Function   : ReaderRefill
+*   Description: This routine moves whole bytes from the bit reader's
+*                buffer into its window until the window can't hold another
+*                byte.  When 8 bytes are buffered they are loaded at once,
+*                otherwise bytes are moved one at a time and the buffer is
+*                refilled from the reader's file when it is empty.
+*   Parameters : reader - pointer to bit reader
+*   Effects    : Bytes are moved into the reader's window.  The window is
+*                left with fewer than 8 free bits unless the input is
+*                exhausted.
+*   Returned   : None
+***************************************************************************/
+static void ReaderRefill(bit_reader_t *reader)
+{
+    const unsigned char *bytes;
+    uint64_t word;
+    unsigned int count, spare;
+    size_t read;
+
+    if (((reader->end - reader->next) >= 8) &&
+        (reader->count <= (WINDOW_BITS - 8)))
+    {
+        /* load 8 bytes msb first and keep the whole bytes that fit */
+        bytes = reader->next;
+        word = ((uint64_t)bytes[0] << 56) | ((uint64_t)bytes[1] << 48) |
+            ((uint64_t)bytes[2] << 40) | ((uint64_t)bytes[3] << 32) |
+            ((uint64_t)bytes[4] << 24) | ((uint64_t)bytes[5] << 16) |
+            ((uint64_t)bytes[6] << 8) | (uint64_t)bytes[7];
+
+        count = (WINDOW_BITS - reader->count) / 8;
+        spare = WINDOW_BITS - reader->count - (8 * count);
+        reader->window |= ((word >> reader->count) >> spare) << spare;
+        reader->next += count;
+        reader->count += 8 * count;
+        return;
+    }
+
+    while (reader->count <= (WINDOW_BITS - 8))
+    {
+        if (reader->next == reader->end)
+        {
+            if (NULL == reader->fp)
+            {
+                break;
+            }
+
+            read = fread(reader->buffer, 1, reader->bufferSize, reader->fp);
+
+            if (0 == read)
+            {
+                break;
+            }
+
+            reader->next = reader->buffer;
+            reader->end = reader->buffer + read;
+        }
+
+        reader->window |=
+            (uint64_t)(*reader->next) << (WINDOW_BITS - 8 - reader->count);
+        reader->next++;
+        reader->count += 8;
+    }
+}
+
+/***************************************************************************
+*   Function   : DecodeSlow
+*   Description: This routine decodes a single codeword without using a
+*                decode table.  It handles unary runs too long for the
+*                decode table, escapes, and the end of the encoded stream.
+*                The 1s in the unary portion are counted by inverting the
+*                window and counting leading zeros, so a run costs one
+*                count per window instead of one loop per bit.  The count
+*                is 64 bits wide, so corrupt input can't overflow it.  The
+*                count is kept in the reader, so when the input ends in the
+*                middle of a codeword, decoding can pick up where it left
+*                off once more input is added.
+*   Parameters : reader - pointer to bit reader with encoded input
+*                k - length of binary portion of encoded word
+*                symbol - pointer to where the decoded symbol is stored
+*   Effects    : The codeword is removed from the bit reader.  If the
+*                input ends first, the unary 1s read so far are removed and
+*                counted in reader->unary, and the rest stays in the
+*                window.
+*   Returned   : 0 for success, EOF if the input ended before a complete
+*                codeword (the remaining bits are pad bits), 1 if the
+*                codeword has more than reader->width bits (errno is set
+*                to EILSEQ).
+***************************************************************************/
+static int DecodeSlow(bit_reader_t *reader, const unsigned char k,
+    uint32_t *symbol)
+{
+    uint64_t inverted;
+    uint64_t unary;
+    uint32_t binary;
+    unsigned int run;
+    int ending;
+
+    unary = reader->unary;
+    ending = 0;
+
+    /* count the 1s in the unary portion */
+    while (!ending && (unary < reader->limit))
+    {
+        if (0 == reader->count)
+        {
+            ReaderRefill(reader);
+
+            if (0 == reader->count)
+            {
+                reader->unary = unary;
+                return EOF;
+            }
+        }
+
+        /* bits past count are 0, so the inverted run stops by count */
+        inverted = ~(reader->window);
+        run = (0 == inverted) ? WINDOW_BITS : CLZ64(inverted);
+
+        if ((unary + run) >= reader->limit)
+        {
+            /* escape, the limit's 1s are followed by the whole symbol */
+            run = (unsigned int)(reader->limit - unary);
+        }
+        else if (run < reader->count)
+        {
+            /* the ending 0 is in the window */
+            ending = 1;
+        }
+
+        /* otherwise the run continues past the window */
+        reader->window = (run < WINDOW_BITS) ? (reader->window << run) : 0;
+        reader->count -= run;
+        unary += run;
+    }
+
+    /* kept until the whole codeword is read */
+    reader->unary = unary;
+
+    if (!ending)
+    {
+        if (reader->count < reader->width)
+        {
+            ReaderRefill(reader);
+
+            if (reader->count < reader->width)
+            {
+                /* the 1s were actually spare bits */
+                return EOF;
+            }
+        }
+
+        *symbol = (uint32_t)PEEK_BITS(reader, reader->width);
+        reader->window <<= reader->width;
+        reader->count -= reader->width;
+        reader->unary = 0;
+        return 0;
+    }
+
+    if (unary > MAX_WORD_UNARY(reader->width, k))
+    {
+        /* decodes to more than width bits */
+        errno = EILSEQ;
+        return 1;
+    }
+
+    if (reader->count < (unsigned int)(k + 1))
+    {
+        ReaderRefill(reader);
+
+        if (reader->count < (unsigned int)(k + 1))
+        {
+            /* unary was actually spare bits */
+            return EOF;
+        }
+    }
+
+    /* skip the ending 0 and extract the binary portion */
+    reader->window <<= 1;
+    binary = 0;
+
+    if (k != 0)
+    {
+        binary = PEEK_BITS(reader, k);
+        reader->window <<= k;
+    }
+
+    reader->count -= k + 1;
+    reader->unary = 0;
+    *symbol = (uint32_t)((unary << k) | binary);
+    return 0;
+}
+
+#if !defined(__GNUC__)
+/***************************************************************************
+*   Function   : CountLeadingZeros
+*   Description: This routine counts the leading 0 bits in a 64 bit word
+*                for compilers without a count leading zeros builtin.
+*   Parameters : word - non-zero word
+*   Effects    : None
+*   Returned   : The number of 0 bits before the most significant 1.
+***************************************************************************/
+static unsigned int CountLeadingZeros(uint64_t word)
+{
+    unsigned int zeros;
+    unsigned int shift;
+
+    zeros = 0;
+
+    for (shift = WINDOW_BITS / 2; shift > 0; shift /= 2)
+    {
+        if (0 == (word >> (WINDOW_BITS - shift)))
+        {
+            zeros += shift;
+            word <<= shift;
+        }
+    }
+
+    return zeros;
+}
+#endif
+
+/***************************************************************************
+*   Function   : DecodeStream
+*   Description: This routine decodes every complete codeword in a bit
+*                reader and writes the decoded symbols to a byte sink.
+*                Table lookups decode every codeword in a window at once.
+*                Long unary runs and the end of the stream are handled one
+*                codeword at a time.
+*   Parameters : reader - pointer to bit reader with encoded input
+*                sink - pointer to byte sink receiving decoded output
+*                k - length of binary portion of encoded word
+*   Effects    : The reader is consumed and decoded symbols are written to
+*                the sink.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int DecodeStream(bit_reader_t *reader, byte_sink_t *sink,
+    const unsigned char k)
+{
+    const decode_entry_t *table;
+    const decode_entry_t *entry;
+    uint32_t symbol;
+    unsigned int count, used, maxUnary;
+    int bmi2, result;
+    ptrdiff_t room;
+
+    if (RICE_ADAPTIVE_K == k)
+    {
+        return DecodeAdaptive(reader, sink);
+    }
+
+    table = GetDecodeTable(k);
+
+    if ((reader->limit < NO_LIMIT) &&
+        (reader->limit < (unsigned int)(DECODE_BITS - k)))
+    {
+        /* escapes may fit in the table's window, it can't tell them apart */
+        table = NULL;
+    }
+
+    if (-1 == useBmi2)
+    {
+        useBmi2 = RiceHaveBmi2();
+    }
+
+    /***********************************************************************
+    * The BMI2 kernel decodes a whole window per call.  Below BMI2_MIN_K
+    * the codewords are short enough that the 12 bit table decodes more
+    * symbols per lookup and wins, so the kernel is only used above it.
+    ***********************************************************************/
+    bmi2 = (NULL != table) && useBmi2 && (k >= BMI2_MIN_K);
+    room = bmi2 ? BMI2_SYMBOLS : DECODE_SYMBOLS;
+    maxUnary = (reader->limit <= MAX_UNARY(k)) ?
+        (reader->limit - 1) : MAX_UNARY(k);
+
+    while (1)
+    {
+        if ((sink->end - sink->next) < room)
+        {
+            if (0 != SinkFlush(sink))
+            {
+                return -1;
+            }
+        }
+
+        if (reader->count < (bmi2 ? (WINDOW_BITS - 7) : DECODE_BITS))
+        {
+            ReaderRefill(reader);
+        }
+
+        if (bmi2 && ((sink->end - sink->next) >= room))
+        {
+            count = RiceDecodeBmi2(reader->window, reader->count, k,
+                maxUnary, sink->next, &used);
+
+            if (0 != count)
+            {
+                sink->next += count;
+                reader->window = (used < WINDOW_BITS) ?
+                    (reader->window << used) : 0;
+                reader->count -= used;
+                continue;
+            }
+        }
+        else if ((NULL != table) && (reader->count >= DECODE_BITS) &&
+            ((sink->end - sink->next) >= DECODE_SYMBOLS))
+        {
+            entry = &table[PEEK_BITS(reader, DECODE_BITS)];
+
+            if (0 != entry->count)
+            {
+                /* copy every slot, only count of them are kept */
+                memcpy(sink->next, entry->symbols, DECODE_SYMBOLS);
+                sink->next += entry->count;
+                reader->window <<= entry->bits;
+                reader->count -= entry->bits;
+                continue;
+            }
+        }
+
+        /* long unary run, escape, end of input, or nearly full sink */
+        result = DecodeSlow(reader, k, &symbol);
+
+        if (EOF == result)
+        {
+            break;
+        }
+        else if (0 != result)
+        {
+            return -1;
+        }
+
+        if (sink->next == sink->end)
+        {
+            /* memory sink is full */
+            errno = ENOBUFS;
+            return -1;
+        }
+
+        *(sink->next) = (unsigned char)symbol;
+        sink->next++;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : DecodeAdaptive
+*   Description: This routine decodes every complete codeword in a bit
+*                reader that was written by EncodeAdaptive.  k for each
+*                codeword comes from the symbols decoded before it, exactly
+*                as it did when encoding, so k changes every symbol and
+*                codewords are decoded one at a time.  Codewords that are
+*                entirely in a full window are decoded in place with one
+*                count of leading 1s; the rest (including escapes) go
+*                through DecodeSlow.
+*   Parameters : reader - pointer to bit reader with encoded input
+*                sink - pointer to byte sink receiving decoded output
+*   Effects    : The reader is consumed and decoded symbols are written to
+*                the sink.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int DecodeAdaptive(bit_reader_t *reader, byte_sink_t *sink)
+{
+    uint64_t inverted;
+    unsigned int k, unary, bits;
+    uint32_t symbol;
+    int result;
+
+    while (1)
+    {
+        if (sink->next == sink->end)
+        {
+            if (0 != SinkFlush(sink))
+            {
+                return -1;
+            }
+        }
+
+        if (reader->count < (WINDOW_BITS / 2))
+        {
+            ReaderRefill(reader);
+        }
+
+        k = AdaptK(&reader->adapt);
+        inverted = ~(reader->window);
+        unary = (0 == inverted) ? WINDOW_BITS : CLZ64(inverted);
+        bits = unary + 1 + k;
+
+        if ((bits <= reader->count) && (bits < WINDOW_BITS) &&
+            (unary < reader->limit) && (unary <= MAX_UNARY(k)) &&
+            (sink->next != sink->end))
+        {
+            /* unary 1s, the ending 0, and k binary bits are all here */
+            symbol = (unsigned char)((unary << k) |
+                ((unsigned int)(reader->window >> (WINDOW_BITS - bits)) &
+                ((1 << k) - 1)));
+            reader->window <<= bits;
+            reader->count -= bits;
+        }
+        else
+        {
+            /* long unary run, escape, or end of input */
+            result = DecodeSlow(reader, (unsigned char)k, &symbol);
+
+            if (EOF == result)
+            {
+                break;
+            }
+            else if (0 != result)
+            {
+                return -1;
+            }
+        }
+
+        if (sink->next == sink->end)
+        {
+            /* memory sink is full */
+            errno = ENOBUFS;
+            return -1;
+        }
+
+        *(sink->next) = (unsigned char)symbol;
+        sink->next++;
+        AdaptUpdate(&reader->adapt, (unsigned char)symbol);
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : DecodeWords
+*   Description: This routine decodes every complete codeword in a bit
+*                reader that was written by EncodeWords and writes the
+*                8 to 32 bit samples to a byte sink.  Codewords that are
+*                entirely in the window are decoded in place with one count
+*                of leading 1s; the rest (including escapes) go through
+*                DecodeSlow.  Signed samples are rebuilt from their
+*                residuals as they are decoded, in the same pass.
+*   Parameters : reader - pointer to bit reader with encoded input (width
+*                         is the sample size)
+*                sink - pointer to byte sink receiving decoded output
+*                options - pointer to k, byte order, and predictor
+*                predictor - pointer to the predictor's sample history
+*   Effects    : The reader is consumed and decoded samples are written to
+*                the sink.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int DecodeWords(bit_reader_t *reader, byte_sink_t *sink,
+    const rice_options_t *options, predictor_t *predictor)
+{
+    uint64_t inverted, maxUnary, binaryMask;
+    uint32_t sample, mask;
+    unsigned int size, unary, bits;
+    unsigned char k;
+    int result;
+
+    k = options->k;
+    size = reader->width / CHAR_BIT;
+    maxUnary = MAX_WORD_UNARY(reader->width, k);
+    binaryMask = (((uint64_t)1) << k) - 1;
+    mask = (uint32_t)((((uint64_t)1) << reader->width) - 1);
+
+    while (1)
+    {
+        if ((sink->end - sink->next) < (ptrdiff_t)size)
+        {
+            if (0 != SinkFlush(sink))
+            {
+                return -1;
+            }
+        }
+
+        if (reader->count < (WINDOW_BITS / 2))
+        {
+            ReaderRefill(reader);
+        }
+
+        inverted = ~(reader->window);
+        unary = (0 == inverted) ? WINDOW_BITS : CLZ64(inverted);
+        bits = unary + 1 + k;
+
+        if ((bits <= reader->count) && (bits < WINDOW_BITS) &&
+            (unary < reader->limit) && (unary <= maxUnary))
+        {
+            /* unary 1s, the ending 0, and k binary bits are all here */
+            sample = (uint32_t)(((uint64_t)unary << k) |
+                ((reader->window >> (WINDOW_BITS - bits)) & binaryMask));
+            reader->window <<= bits;
+            reader->count -= bits;
+        }
+        else
+        {
+            /* long unary run, escape, or end of input */
+            result = DecodeSlow(reader, k, &sample);
+
+            if (EOF == result)
+            {
+                break;
+            }
+            else if (0 != result)
+            {
+                return -1;
+            }
+        }
+
+        if ((sink->end - sink->next) < (ptrdiff_t)size)
+        {
+            /* memory sink is full */
+            errno = ENOBUFS;
+            return -1;
+        }
+
+        if (RICE_UNSIGNED != options->predictor)
+        {
+            sample = PredictSample(predictor, UNZIGZAG(sample, mask), mask);
+        }
+
+        StoreSample(sink->next, sample, size, options->order);
+        sink->next += size;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : PredictSample
+*   Description: This routine rebuilds a signed sample from its prediction
+*                residual by adding the fixed predictor's prediction from
+*                the samples before it, modulo 2^width.
+*   Parameters : predictor - pointer to the predictor's order and history
+*                residual - residual for the sample (after UNZIGZAG)
+*                mask - the low width bits set
+*   Effects    : The sample is added to the predictor history.
+*   Returned   : The rebuilt sample.
+***************************************************************************/
+static uint32_t PredictSample(predictor_t *predictor, const uint32_t residual,
+    const uint32_t mask)
+{
+    uint32_t *last;
+    uint32_t sample;
+
+    /* last[MAX_ORDER - 1] is the most recent sample */
+    last = predictor->last;
+
+    switch (predictor->order)
+    {
+        case 0:
+            sample = residual;
+            break;
+
+        case 1:
+            sample = residual + last[2];
+            break;
+
+        case 2:
+            sample = residual + (2 * last[2]) - last[1];
+            break;
+
+        default:
+            sample = residual + (3 * last[2]) - (3 * last[1]) + last[0];
+            break;
+    }
+
+    sample &= mask;
+    last[0] = last[1];
+    last[1] = last[2];
+    last[2] = sample;
+    return sample;
+}
+
+/***************************************************************************
+*   Function   : StoreSample
+*   Description: This routine converts a 32 bit word to a sample stored
+*                as bytes in either byte order (the reverse of
+*                LoadSamples).
+*   Parameters : bytes - pointer to size bytes receiving the sample
+*                sample - sample to store
+*                size - bytes in the sample
+*                order - byte order of the sample
+*   Effects    : bytes is filled in.
+*   Returned   : None
+***************************************************************************/
+static void StoreSample(unsigned char *bytes, uint32_t sample,
+    const unsigned int size, const unsigned char order)
+{
+    unsigned int j;
+
+    if (RICE_BIG_ENDIAN == order)
+    {
+        for (j = size; j > 0; j--)
+        {
+            bytes[j - 1] = (unsigned char)sample;
+            sample >>= CHAR_BIT;
+        }
+    }
+    else
+    {
+        for (j = 0; j < size; j++)
+        {
+            bytes[j] = (unsigned char)sample;
+            sample >>= CHAR_BIT;
+        }
+    }
+}
+
+/***************************************************************************
+*   Function   : SinkFlush
+*   Description: This routine writes the contents of a byte sink's buffer
+*                to its file and empties the buffer.  Sinks without a file
+*                are caller memory, so there is nothing to write.
+*   Parameters : sink - pointer to byte sink
+*   Effects    : Buffered bytes are written to the sink's file.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int SinkFlush(byte_sink_t *sink)
+{
+    size_t count;
+
+    if (NULL == sink->fp)
+    {
+        return 0;
+    }
+
+    count = sink->next - sink->buffer;
+
+    if (count != fwrite(sink->buffer, 1, count, sink->fp))
+    {
+        return -1;
+    }
+
+    sink->flushed += count;
+    sink->next = sink->buffer;
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : AdaptInit
+*   Description: This routine sets adaptive k statistics to their starting
+*                values.
+*   Parameters : adapt - pointer to adaptive k statistics
+*   Effects    : adapt is initialized.
+*   Returned   : None
+***************************************************************************/
+static void AdaptInit(adapt_t *adapt)
+{
+    adapt->sum = ADAPT_SUM;
+    adapt->count = ADAPT_COUNT;
+}
+
+/***************************************************************************
+*   Function   : AdaptK
+*   Description: This routine picks k for the next adaptive symbol the way
+*                JPEG-LS (LOCO-I) does: the smallest k with
+*                count << k >= sum, which tracks log2 of the mean of the
+*                recent symbols.  Instead of trying each k, it starts from
+*                the difference in bit lengths of sum and count, so at most
+*                one comparison is needed.
+*   Parameters : adapt - pointer to adaptive k statistics
+*   Effects    : None
+*   Returned   : k for the next symbol, 0 to ADAPT_MAX_K.
+***************************************************************************/
+static unsigned char AdaptK(const adapt_t *adapt)
+{
+    int k;
+
+    /* sum | 1 keeps CLZ64 defined, a sum of 0 or 1 gives k = 0 either way */
+    k = (int)CLZ64(adapt->count) - (int)CLZ64(adapt->sum | 1);
+    k = (k > 0) ? k : 0;
+    k += ((uint64_t)adapt->count << k) < adapt->sum;
+    return (unsigned char)((k > ADAPT_MAX_K) ? ADAPT_MAX_K : k);
+}
+
+/***************************************************************************
+*   Function   : AdaptUpdate
+*   Description: This routine adds a symbol to the adaptive k statistics.
+*                Every ADAPT_RESET symbols the sum and count are halved, so
+*                older symbols count for less and k follows drifting data.
+*   Parameters : adapt - pointer to adaptive k statistics
+*                symbol - symbol that was just coded
+*   Effects    : adapt is updated.
+*   Returned   : None
+***************************************************************************/
+static void AdaptUpdate(adapt_t *adapt, const unsigned char symbol)
+{
+    adapt->sum += symbol;
+    adapt->count++;
+
+    if (ADAPT_RESET == adapt->count)
+    {
+        adapt->sum >>= 1;
+        adapt->count >>= 1;
+    }
 }
@@ -33,9 +33,66 @@
 #ifndef _RICE_H_
 #define _RICE_H_
 
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
 /***************************************************************************
 *                                CONSTANTS
 ***************************************************************************/
+/* returned by functions that return a size when they fail */
+#define RICE_ERROR      ((size_t)-1)
+
+/* framed stream block sizes (bytes of unencoded input per block) */
+#define RICE_BLOCK_SIZE         (1 << 20)   /* default */
+#define RICE_MAX_BLOCK_SIZE     (1 << 24)   /* largest allowed */
+
+/* k for the framed stream functions to pick the best k for each block */
+#define RICE_AUTO_K             0
+
+/* k that picks a new k for each symbol from the symbols before it */
+#define RICE_ADAPTIVE_K         0x80
+
+/* most worker threads a framed stream function will start */
+#define RICE_MAX_THREADS        256
+
+/* largest unary length that starts an escape (0 for no escapes) */
+#define RICE_MAX_LIMIT          255
+
+/* byte orders of the samples coded by the sample functions */
+#define RICE_BIG_ENDIAN         0
+#define RICE_LITTLE_ENDIAN      1
+
+/* sample predictors, RICE_PREDICT_n codes signed samples with an order n */
+#define RICE_UNSIGNED           0   /* unsigned samples as they are */
+#define RICE_PREDICT_0          1   /* signed samples */
+#define RICE_PREDICT_1          2   /* signed first differences */
+#define RICE_PREDICT_2          3   /* signed second differences */
+#define RICE_PREDICT_3          4   /* signed third differences */
+
+/* sample function flags */
+#define RICE_FLAG_HEADER        0x01    /* stream starts with a header */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* options for the Ex and sample functions, zeroed fields use defaults */
+typedef struct
+{
+    unsigned char k;            /* length of binary portion or auto */
+    unsigned int threads;       /* worker threads, 0 or 1 for none */
+    size_t blockSize;           /* input bytes per block */
+    unsigned int limit;         /* unary length of an escape, 0 for none */
+    unsigned char width;        /* bits per sample (8, 16, 24, 32) */
+    unsigned char order;        /* byte order of samples wider than 8 */
+    unsigned char predictor;    /* RICE_UNSIGNED or RICE_PREDICT_n */
+    unsigned char flags;        /* RICE_FLAG_ values */
+} rice_options_t;
+
+/* incremental encoder or decoder, see RiceEncodeInit and RiceDecodeInit */
+typedef struct rice_stream_t rice_stream_t;
 
 /***************************************************************************
 *                               PROTOTYPES
@@ -46,4 +103,64 @@ int RiceEncodeFile(FILE *inFile, FILE *outFile, const unsigned char k);
 /* decode inFile*/
 int RiceDecodeFile(FILE *inFile, FILE *outFile, const unsigned char k);
 
+/* encode n bytes of in into out, returns bytes written to out */
+size_t RiceEncodeBuffer(const uint8_t *in, const size_t n, uint8_t *out,
+    const size_t cap, const unsigned char k);
+
+/* decode n bytes of in into out, returns bytes written to out */
+size_t RiceDecodeBuffer(const uint8_t *in, const size_t n, uint8_t *out,
+    const size_t cap, const unsigned char k);
+
+/* RiceEncodeBuffer with the k and escape limit in options */
+size_t RiceEncodeBufferEx(const uint8_t *in, const size_t n, uint8_t *out,
+    const size_t cap, const rice_options_t *options);
+
+/* RiceDecodeBuffer with the k and escape limit in options */
+size_t RiceDecodeBufferEx(const uint8_t *in, const size_t n, uint8_t *out,
+    const size_t cap, const rice_options_t *options);
+
+/* find the k that encodes n bytes of in in the fewest bits */
+unsigned char RiceBestK(const uint8_t *in, const size_t n);
+
+/* encode inFile as 8 to 32 bit samples */
+int RiceEncodeSamples(FILE *inFile, FILE *outFile,
+    const rice_options_t *options);
+
+/* decode a stream of samples written by RiceEncodeSamples */
+int RiceDecodeSamples(FILE *inFile, FILE *outFile,
+    const rice_options_t *options);
+
+/* start encoding a sample stream that is passed in pieces */
+rice_stream_t *RiceEncodeInit(const rice_options_t *options);
+
+/* encode up to *n bytes of in into out, returns bytes written to out */
+size_t RiceEncodeUpdate(rice_stream_t *stream, const uint8_t *in, size_t *n,
+    uint8_t *out, const size_t cap);
+
+/* write the end of an encoded stream, done when less than cap is returned */
+size_t RiceEncodeFinish(rice_stream_t *stream, uint8_t *out,
+    const size_t cap);
+
+/* start decoding a sample stream that is passed in pieces */
+rice_stream_t *RiceDecodeInit(const rice_options_t *options);
+
+/* decode up to *n bytes of in into out, returns bytes written to out */
+size_t RiceDecodeUpdate(rice_stream_t *stream, const uint8_t *in, size_t *n,
+    uint8_t *out, const size_t cap);
+
+/* write the end of a decoded stream, done when less than cap is returned */
+size_t RiceDecodeFinish(rice_stream_t *stream, uint8_t *out,
+    const size_t cap);
+
+/* free a stream from RiceEncodeInit or RiceDecodeInit */
+void RiceStreamFree(rice_stream_t *stream);
+
+/* encode inFile as a stream of independently encoded blocks */
+int RiceEncodeFileEx(FILE *inFile, FILE *outFile,
+    const rice_options_t *options);
+
+/* decode a stream of blocks written by RiceEncodeFileEx */
+int RiceDecodeFileEx(FILE *inFile, FILE *outFile,
+    const rice_options_t *options);
+
 #endif  /* ndef _RICE_H_ */
@@ -0,0 +1,1532 @@
+/***************************************************************************
+*                  Rice Framed Block Stream Functions
+*
+*   File    : riceframe.c
+*   Purpose : Provide functions for Rice encoding and decoding file streams
+*             as a sequence of independently coded blocks.  Blocks are
+*             coded on a pool of worker threads and written in order.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Rice: ANSI C Rice Encoding/Decoding Routines
+* Copyright (C) 2008 - 2015, 2026 by
+* Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the rice library.
+*
+* The rice library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The rice library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+* Framed stream layout.  Each block of input is encoded on its own and
+* written as a header followed by its encoded bytes:
+*
+*   k               1 byte, length of binary portion
+*   limit           1 byte, unary length of an escape (0 for none)
+*   raw length      4 bytes, big endian, unencoded bytes in the block
+*   encoded length  4 bytes, big endian, encoded bytes that follow
+*   encoded bytes   RiceEncodeBufferEx output for the block
+*
+* Every block starts on a byte boundary and needs nothing from the blocks
+* before it, so blocks may be coded in any order by any number of threads.
+* The output doesn't depend on the number of threads.
+*
+* The blocks are followed by an index that lets a decoder find every block
+* without reading the ones before it:
+*
+*   marker          1 byte, INDEX_MARKER (never a valid k)
+*   entries         for each block, its stream offset (8 bytes, big
+*                   endian) and raw length (4 bytes, big endian)
+*   block count     4 bytes, big endian
+*   magic           4 bytes, INDEX_MAGIC
+*
+* Offsets are from the start of the stream.  The index is found by reading
+* the trailing block count and magic from the end of the file.
+***************************************************************************/
+
+/* pthreads and the other POSIX interfaces aren't visible with -ansi */
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "rice.h"
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define BLOCK_HEADER_SIZE   10      /* k, limit, raw and encoded lengths */
+#define MAX_K               7       /* largest k written to a block */
+
+/* k values that may be written to a block */
+#define VALID_K(k)          (((k) <= MAX_K) || (RICE_ADAPTIVE_K == (k)))
+#define BLOCKS_PER_THREAD   2       /* blocks in flight for each worker */
+
+#define INDEX_MARKER        0xFF    /* first byte of the index */
+#define INDEX_ENTRY_SIZE    12      /* block offset and raw length */
+#define INDEX_TRAILER_SIZE  8       /* block count and magic */
+#define INDEX_MAGIC         "RIDX"  /* last 4 bytes of a framed stream */
+#define INDEX_MIN_ENTRIES   64      /* first allocation of index entries */
+
+/***************************************************************************
+*                            TYPE DEFINITIONS
+***************************************************************************/
+/* where a block is in its trip from reader to coder to writer */
+typedef enum
+{
+    BLOCK_EMPTY,                    /* owned by the calling thread */
+    BLOCK_READY,                    /* waiting for a worker */
+    BLOCK_DONE                      /* coded, waiting to be written */
+} block_state_t;
+
+/* a block of unencoded bytes and its encoded form */
+typedef struct
+{
+    unsigned char *raw;             /* unencoded bytes */
+    size_t rawSize;                 /* size of raw buffer */
+    size_t rawLength;               /* number of unencoded bytes */
+    unsigned char *coded;           /* encoded bytes */
+    size_t codedSize;               /* size of coded buffer */
+    size_t codedLength;             /* number of encoded bytes */
+    unsigned char k;                /* length of binary portion */
+    unsigned char limit;            /* unary length of an escape */
+    int error;                      /* errno from coding, 0 for success */
+    block_state_t state;
+} block_t;
+
+/* ring of blocks coded in order by a pool of worker threads */
+typedef struct
+{
+    block_t *blocks;                /* ring of blocks */
+    unsigned int count;             /* number of blocks in ring */
+    int encode;                     /* non-zero to encode, 0 to decode */
+    unsigned long submitted;        /* blocks handed to the workers */
+    unsigned long taken;            /* blocks taken by the workers */
+    int quit;                       /* non-zero when workers must exit */
+    pthread_mutex_t lock;           /* protects everything above */
+    pthread_cond_t work;            /* a block was submitted or quit set */
+    pthread_cond_t done;            /* a block was coded */
+    pthread_t *threads;             /* worker threads */
+    unsigned int threadCount;       /* number of worker threads */
+} block_pool_t;
+
+/* index entries accumulated while blocks are written */
+typedef struct
+{
+    unsigned char *entries;         /* INDEX_ENTRY_SIZE bytes per block */
+    size_t size;                    /* size of entries buffer */
+    uint32_t count;                 /* number of blocks */
+    uint64_t offset;                /* stream offset of the next block */
+} block_index_t;
+
+/* state shared by the threads decoding blocks found through the index */
+typedef struct
+{
+    int inFd;                       /* descriptor of encoded file */
+    int outFd;                      /* descriptor of decoded file */
+    off_t inStart;                  /* file offset of the encoded stream */
+    off_t outStart;                 /* file offset of the decoded output */
+    uint64_t *offsets;              /* stream offset of each block + index */
+    uint64_t *outOffsets;           /* output offset of each block + end */
+    uint32_t count;                 /* number of blocks */
+    uint32_t next;                  /* next block to be decoded */
+    int error;                      /* errno of first failure, 0 for none */
+    pthread_mutex_t lock;           /* protects next and error */
+} indexed_decode_t;
+
+/* reads the next block into an empty block, returns 1, 0 at EOF, or -1 */
+typedef int (*block_read_t)(FILE *fp, block_t *block,
+    const rice_options_t *options);
+
+/* writes a coded block, returns 0 or -1 */
+typedef int (*block_write_t)(FILE *fp, const block_t *block);
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+static int CodeFile(FILE *inFile, FILE *outFile,
+    const rice_options_t *options, const int encode);
+
+static int PoolStart(block_pool_t *pool, const unsigned int threads,
+    const int encode);
+static void PoolStop(block_pool_t *pool);
+static void PoolSubmit(block_pool_t *pool, block_t *block);
+static void PoolWait(block_pool_t *pool, block_t *block);
+static void *PoolWorker(void *arg);
+
+static void CodeBlock(block_t *block, const int encode);
+static int EncodeBlock(block_t *block);
+static int DecodeBlock(block_t *block);
+static int GrowBuffer(unsigned char **buffer, size_t *size,
+    const size_t needed);
+static size_t EncodeBound(const size_t n, const unsigned char k,
+    const unsigned char limit);
+
+static int ReadRawBlock(FILE *fp, block_t *block,
+    const rice_options_t *options);
+static int ReadFramedBlock(FILE *fp, block_t *block,
+    const rice_options_t *options);
+static int WriteRawBlock(FILE *fp, const block_t *block);
+static int WriteFramedBlock(FILE *fp, const block_t *block);
+
+static int IndexAdd(block_index_t *index, const block_t *block);
+static int WriteIndex(FILE *fp, const block_index_t *index);
+static int SkipIndex(FILE *fp, const unsigned long count);
+
+static int DecodeIndexed(FILE *inFile, FILE *outFile,
+    const unsigned int threads);
+static int ReadIndex(indexed_decode_t *decode, const uint64_t size);
+static void *IndexedWorker(void *arg);
+static int DecodeIndexedBlock(indexed_decode_t *decode, block_t *block,
+    const uint32_t i);
+static int ReadAt(const int fd, unsigned char *buffer, const size_t count,
+    const off_t offset);
+static int WriteAt(const int fd, const unsigned char *buffer,
+    const size_t count, const off_t offset);
+
+static void PutUint32(unsigned char *bytes, const uint32_t value);
+static uint32_t GetUint32(const unsigned char *bytes);
+static void PutUint64(unsigned char *bytes, const uint64_t value);
+static uint64_t GetUint64(const unsigned char *bytes);
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+/***************************************************************************
+*   Function   : RiceEncodeFileEx
+*   Description: This routine reads an input file and writes out a framed
+*                Rice encoded version of that file.  The input is split
+*                into blocks which are encoded independently on a pool of
+*                worker threads and written in input order.
+*   Parameters : inFile - pointer to open file to encode
+*                outFile - pointer to open file receiving encoded output
+*                options - pointer to k, thread count, block size, and
+*                          escape limit.  A k of RICE_AUTO_K picks the best
+*                          k for each block.
+*   Effects    : File is encoded as a sequence of Rice encoded blocks.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.  Either way, inFile and outFile will
+*                be left open.
+***************************************************************************/
+int RiceEncodeFileEx(FILE *inFile, FILE *outFile,
+    const rice_options_t *options)
+{
+    return CodeFile(inFile, outFile, options, 1);
+}
+
+/***************************************************************************
+*   Function   : RiceDecodeFileEx
+*   Description: This routine reads a framed Rice encoded input file and
+*                writes the decoded output.  Each block carries its own k
+*                and limit, so options->k and options->limit are not used.
+*                When there are worker threads and both files are regular
+*                files, the workers find the blocks through the stream's
+*                index and decode them straight to their place in the
+*                output.  Otherwise blocks are read in order, decoded on a
+*                pool of worker threads, and written in stream order.
+*   Parameters : inFile - pointer to open file to decode
+*                outFile - pointer to open file receiving decoded output
+*                options - pointer to thread count
+*   Effects    : File is decoded using the Rice algorithm.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure (EILSEQ for a malformed stream).
+*                Either way, inFile and outFile will be left open.
+***************************************************************************/
+int RiceDecodeFileEx(FILE *inFile, FILE *outFile,
+    const rice_options_t *options)
+{
+    int result;
+
+    if ((NULL != inFile) && (NULL != outFile) && (NULL != options) &&
+        (options->threads > 1) && (options->threads <= RICE_MAX_THREADS))
+    {
+        result = DecodeIndexed(inFile, outFile, options->threads);
+
+        if (1 != result)
+        {
+            return result;
+        }
+
+        /* files can't be accessed by offset or there's no usable index */
+    }
+
+    return CodeFile(inFile, outFile, options, 0);
+}
+
+/***************************************************************************
+*   Function   : CodeFile
+*   Description: This routine moves blocks from an input file, through the
+*                worker pool, and to an output file.  The calling thread
+*                reads blocks into the ring as long as there is an empty
+*                block, then waits for the oldest block to be coded and
+*                writes it, so blocks come out in the order they went in.
+*   Parameters : inFile - pointer to open file to code
+*                outFile - pointer to open file receiving coded output
+*                options - pointer to k, thread count, block size, and
+*                          escape limit
+*                encode - non-zero to encode, 0 to decode
+*   Effects    : inFile is encoded or decoded to outFile.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int CodeFile(FILE *inFile, FILE *outFile,
+    const rice_options_t *options, const int encode)
+{
+    block_pool_t pool;
+    block_index_t index;
+    block_t *block;
+    block_read_t readBlock;
+    block_write_t writeBlock;
+    unsigned long read, written;
+    unsigned char k;
+    int result, eof;
+
+    /* validate input and output files */
+    if ((NULL == inFile) || (NULL == outFile))
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    if ((NULL == options) || !VALID_K(options->k) ||
+        (options->limit > RICE_MAX_LIMIT) ||
+        (options->threads > RICE_MAX_THREADS) ||
+        (options->blockSize > RICE_MAX_BLOCK_SIZE))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /***********************************************************************
+    * The encode and decode tables are built the first time they're used.
+    * Using them once for every k before the workers start keeps the
+    * building single threaded.
+    ***********************************************************************/
+    for (k = 0; k <= MAX_K; k++)
+    {
+        RiceEncodeBuffer(NULL, 0, NULL, 0, k);
+        RiceDecodeBuffer(NULL, 0, NULL, 0, k);
+    }
+
+    if (0 != PoolStart(&pool, options->threads, encode))
+    {
+        return -1;
+    }
+
+    readBlock = encode ? ReadRawBlock : ReadFramedBlock;
+    writeBlock = encode ? WriteFramedBlock : WriteRawBlock;
+
+    memset(&index, 0, sizeof(index));
+    read = 0;
+    written = 0;
+    eof = 0;
+    result = 0;
+
+    while (0 == result)
+    {
+        /* keep every empty block in the ring busy */
+        while (!eof && ((read - written) < pool.count))
+        {
+            block = &pool.blocks[read % pool.count];
+            result = readBlock(inFile, block, options);
+
+            if (1 != result)
+            {
+                eof = 1;
+                break;
+            }
+
+            result = 0;
+            PoolSubmit(&pool, block);
+            read++;
+        }
+
+        if ((0 != result) || (written == read))
+        {
+            break;
+        }
+
+        /* write the oldest block once it's coded */
+        block = &pool.blocks[written % pool.count];
+        PoolWait(&pool, block);
+
+        if (0 != block->error)
+        {
+            errno = block->error;
+            result = -1;
+            break;
+        }
+
+        result = writeBlock(outFile, block);
+
+        if (encode && (0 == result))
+        {
+            result = IndexAdd(&index, block);
+        }
+
+        block->state = BLOCK_EMPTY;
+        written++;
+    }
+
+    if (0 == result)
+    {
+        result = encode ? WriteIndex(outFile, &index) :
+            SkipIndex(inFile, read);
+    }
+
+    PoolStop(&pool);
+    free(index.entries);
+    return result;
+}
+
+/***************************************************************************
+*   Function   : PoolStart
+*   Description: This routine allocates the block ring and starts the
+*                worker threads of a block pool.  A pool without worker
+*                threads has one block, which is coded by the calling
+*                thread when it is submitted.
+*   Parameters : pool - pointer to pool to start
+*                threads - number of worker threads, 0 or 1 for none
+*                encode - non-zero to encode blocks, 0 to decode them
+*   Effects    : The pool's block ring is allocated and its threads run.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int PoolStart(block_pool_t *pool, const unsigned int threads,
+    const int encode)
+{
+    unsigned int i;
+    int error;
+
+    pool->threadCount = (threads > 1) ? threads : 0;
+    pool->count = (0 == pool->threadCount) ? 1 :
+        (pool->threadCount * BLOCKS_PER_THREAD);
+    pool->encode = encode;
+    pool->submitted = 0;
+    pool->taken = 0;
+    pool->quit = 0;
+    pool->threads = NULL;
+
+    pool->blocks = (block_t *)calloc(pool->count, sizeof(block_t));
+
+    if (NULL == pool->blocks)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (0 == pool->threadCount)
+    {
+        return 0;
+    }
+
+    pool->threads = (pthread_t *)malloc(pool->threadCount * sizeof(pthread_t));
+
+    if (NULL == pool->threads)
+    {
+        free(pool->blocks);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (i = 0; i < pool->threadCount; i++)
+    {
+        error = pthread_create(&pool->threads[i], NULL, PoolWorker, pool);
+
+        if (0 != error)
+        {
+            /* stop the threads that did start */
+            pool->threadCount = i;
+            PoolStop(pool);
+            errno = error;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : PoolStop
+*   Description: This routine tells the worker threads of a block pool to
+*                exit, waits for them, and frees the pool's memory.  Blocks
+*                that were submitted but not taken by a worker are dropped.
+*   Parameters : pool - pointer to pool to stop
+*   Effects    : The pool's threads are joined and its memory is freed.
+*   Returned   : None
+***************************************************************************/
+static void PoolStop(block_pool_t *pool)
+{
+    unsigned int i;
+
+    if (NULL != pool->threads)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->quit = 1;
+        pthread_cond_broadcast(&pool->work);
+        pthread_mutex_unlock(&pool->lock);
+
+        for (i = 0; i < pool->threadCount; i++)
+        {
+            pthread_join(pool->threads[i], NULL);
+        }
+
+        pthread_cond_destroy(&pool->done);
+        pthread_cond_destroy(&pool->work);
+        pthread_mutex_destroy(&pool->lock);
+        free(pool->threads);
+    }
+
+    for (i = 0; i < pool->count; i++)
+    {
+        free(pool->blocks[i].raw);
+        free(pool->blocks[i].coded);
+    }
+
+    free(pool->blocks);
+}
+
+/***************************************************************************
+*   Function   : PoolSubmit
+*   Description: This routine hands a block that has been read to the
+*                worker threads.  Pools without workers code the block
+*                before returning.
+*   Parameters : pool - pointer to pool
+*                block - pointer to the next block in the ring
+*   Effects    : The block will be coded.
+*   Returned   : None
+***************************************************************************/
+static void PoolSubmit(block_pool_t *pool, block_t *block)
+{
+    if (0 == pool->threadCount)
+    {
+        CodeBlock(block, pool->encode);
+        block->state = BLOCK_DONE;
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    block->state = BLOCK_READY;
+    pool->submitted++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/***************************************************************************
+*   Function   : PoolWait
+*   Description: This routine waits for a submitted block to be coded.
+*   Parameters : pool - pointer to pool
+*                block - pointer to a submitted block
+*   Effects    : The calling thread blocks until block is coded.
+*   Returned   : None
+***************************************************************************/
+static void PoolWait(block_pool_t *pool, block_t *block)
+{
+    if (0 == pool->threadCount)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (BLOCK_DONE != block->state)
+    {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/***************************************************************************
+*   Function   : PoolWorker
+*   Description: This routine is the body of a worker thread.  It takes
+*                submitted blocks in ring order and codes them until the
+*                pool is stopped.
+*   Parameters : arg - pointer to the block pool
+*   Effects    : Submitted blocks are coded.
+*   Returned   : NULL
+***************************************************************************/
+static void *PoolWorker(void *arg)
+{
+    block_pool_t *pool;
+    block_t *block;
+
+    pool = (block_pool_t *)arg;
+    pthread_mutex_lock(&pool->lock);
+
+    while (1)
+    {
+        while (!pool->quit && (pool->taken == pool->submitted))
+        {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+
+        if (pool->quit)
+        {
+            break;
+        }
+
+        block = &pool->blocks[pool->taken % pool->count];
+        pool->taken++;
+        pthread_mutex_unlock(&pool->lock);
+
+        CodeBlock(block, pool->encode);
+
+        pthread_mutex_lock(&pool->lock);
+        block->state = BLOCK_DONE;
+        pthread_cond_broadcast(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/***************************************************************************
+*   Function   : CodeBlock
+*   Description: This routine encodes or decodes a block and records the
+*                errno of any failure in the block, since errno belongs to
+*                the thread that did the coding.
+*   Parameters : block - pointer to block to code
+*                encode - non-zero to encode, 0 to decode
+*   Effects    : The block is coded.
+*   Returned   : None
+***************************************************************************/
+static void CodeBlock(block_t *block, const int encode)
+{
+    int result;
+
+    result = encode ? EncodeBlock(block) : DecodeBlock(block);
+    block->error = (0 == result) ? 0 : errno;
+}
+
+/***************************************************************************
+*   Function   : EncodeBlock
+*   Description: This routine encodes a block's raw bytes into its coded
+*                buffer.  Blocks with a k of RICE_AUTO_K are encoded with
+*                the k that RiceBestK picks for them.  The first try uses a
+*                buffer a little larger than the input; if that isn't
+*                enough the buffer is grown to the worst case size and the
+*                block is encoded again.
+*   Parameters : block - pointer to block to encode
+*   Effects    : The block's k, coded bytes, and length are set.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int EncodeBlock(block_t *block)
+{
+    rice_options_t options;
+    size_t length;
+
+    if (RICE_AUTO_K == block->k)
+    {
+        block->k = RiceBestK(block->raw, block->rawLength);
+    }
+
+    memset(&options, 0, sizeof(options));
+    options.k = block->k;
+    options.limit = block->limit;
+
+    if (0 != GrowBuffer(&block->coded, &block->codedSize,
+        block->rawLength + (block->rawLength / 8) + 1))
+    {
+        return -1;
+    }
+
+    length = RiceEncodeBufferEx(block->raw, block->rawLength, block->coded,
+        block->codedSize, &options);
+
+    if ((RICE_ERROR == length) && (ENOBUFS == errno))
+    {
+        if (0 != GrowBuffer(&block->coded, &block->codedSize,
+            EncodeBound(block->rawLength, block->k, block->limit)))
+        {
+            return -1;
+        }
+
+        length = RiceEncodeBufferEx(block->raw, block->rawLength,
+            block->coded, block->codedSize, &options);
+    }
+
+    if (RICE_ERROR == length)
+    {
+        return -1;
+    }
+
+    block->codedLength = length;
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : DecodeBlock
+*   Description: This routine decodes a block's coded bytes into its raw
+*                buffer and checks that it decodes to the length recorded
+*                in its header.
+*   Parameters : block - pointer to block to decode
+*   Effects    : The block's raw bytes are set.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int DecodeBlock(block_t *block)
+{
+    rice_options_t options;
+    size_t length;
+
+    if (0 != GrowBuffer(&block->raw, &block->rawSize, block->rawLength))
+    {
+        return -1;
+    }
+
+    memset(&options, 0, sizeof(options));
+    options.k = block->k;
+    options.limit = block->limit;
+    length = RiceDecodeBufferEx(block->coded, block->codedLength, block->raw,
+        block->rawLength, &options);
+
+    if (RICE_ERROR == length)
+    {
+        /* EILSEQ for a codeword that isn't a byte */
+        return -1;
+    }
+
+    if (length != block->rawLength)
+    {
+        /* too many or too few symbols for the header */
+        errno = EILSEQ;
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : GrowBuffer
+*   Description: This routine makes sure a block buffer holds at least
+*                needed bytes.  Buffers only grow, so blocks reuse them.
+*   Parameters : buffer - pointer to the buffer pointer
+*                size - pointer to the size of the buffer
+*                needed - number of bytes needed
+*   Effects    : The buffer may be reallocated.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int GrowBuffer(unsigned char **buffer, size_t *size,
+    const size_t needed)
+{
+    unsigned char *grown;
+
+    if (needed <= *size)
+    {
+        return 0;
+    }
+
+    grown = (unsigned char *)realloc(*buffer, needed);
+
+    if (NULL == grown)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    *buffer = grown;
+    *size = needed;
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : EncodeBound
+*   Description: This routine computes the largest number of bytes that n
+*                bytes can encode to.  The longest codeword is either the
+*                one for 255, (255 >> k) 1s, an ending 0, and k binary
+*                bits, or an escape, limit 1s and 8 raw bits.  Adaptive k
+*                may use any k, so its bound is the one for 0.
+*   Parameters : n - number of bytes to encode
+*                k - length of binary portion of encoded word
+*                limit - unary length of an escape, 0 for none
+*   Effects    : None
+*   Returned   : Worst case encoded size in bytes.
+***************************************************************************/
+static size_t EncodeBound(const size_t n, const unsigned char k,
+    const unsigned char limit)
+{
+    size_t bits;
+
+    if (RICE_ADAPTIVE_K == k)
+    {
+        return EncodeBound(n, 0, limit);
+    }
+
+    bits = (255 >> k) + 1 + k;
+
+    if ((size_t)(limit + 8) > bits)
+    {
+        bits = limit + 8;
+    }
+
+    return ((n * bits) + 7) / 8;
+}
+
+/***************************************************************************
+*   Function   : ReadRawBlock
+*   Description: This routine reads the next block of unencoded bytes.
+*   Parameters : fp - pointer to open file being encoded
+*                block - pointer to empty block
+*                options - pointer to k, block size, and escape limit
+*   Effects    : Up to a block size of bytes are read into the block.
+*   Returned   : 1 if a block was read, 0 at the end of the file, or -1 for
+*                failure.  errno will be set in the event of a failure.
+***************************************************************************/
+static int ReadRawBlock(FILE *fp, block_t *block,
+    const rice_options_t *options)
+{
+    size_t blockSize;
+
+    blockSize = (0 == options->blockSize) ? RICE_BLOCK_SIZE :
+        options->blockSize;
+
+    if (0 != GrowBuffer(&block->raw, &block->rawSize, blockSize))
+    {
+        return -1;
+    }
+
+    block->rawLength = fread(block->raw, 1, blockSize, fp);
+    block->k = options->k;
+    block->limit = (unsigned char)options->limit;
+
+    if (ferror(fp))
+    {
+        return -1;
+    }
+
+    return (0 == block->rawLength) ? 0 : 1;
+}
+
+/***************************************************************************
+*   Function   : ReadFramedBlock
+*   Description: This routine reads the header and encoded bytes of the
+*                next block of a framed stream.  The index that follows the
+*                last block ends the stream.
+*   Parameters : fp - pointer to open file being decoded
+*                block - pointer to empty block
+*                options - not used
+*   Effects    : The block's k, limit, lengths, and encoded bytes are read.
+*   Returned   : 1 if a block was read, 0 at the index, or -1 for
+*                failure.  errno will be set in the event of a failure
+*                (EILSEQ for a malformed or truncated block).
+***************************************************************************/
+static int ReadFramedBlock(FILE *fp, block_t *block,
+    const rice_options_t *options)
+{
+    unsigned char header[BLOCK_HEADER_SIZE];
+    int c;
+
+    (void)options;
+    c = fgetc(fp);
+
+    if (INDEX_MARKER == c)
+    {
+        /* the index follows the last block */
+        return 0;
+    }
+
+    header[0] = (unsigned char)c;
+
+    if ((EOF == c) ||
+        ((BLOCK_HEADER_SIZE - 1) != fread(header + 1, 1,
+        BLOCK_HEADER_SIZE - 1, fp)))
+    {
+        if (!ferror(fp))
+        {
+            /* every stream ends with an index */
+            errno = EILSEQ;
+        }
+
+        return -1;
+    }
+
+    block->k = header[0];
+    block->limit = header[1];
+    block->rawLength = GetUint32(header + 2);
+    block->codedLength = GetUint32(header + 6);
+
+    if (!VALID_K(block->k) ||
+        (block->rawLength > RICE_MAX_BLOCK_SIZE) ||
+        (block->codedLength >
+        EncodeBound(block->rawLength, block->k, block->limit)))
+    {
+        errno = EILSEQ;
+        return -1;
+    }
+
+    if (0 != GrowBuffer(&block->coded, &block->codedSize,
+        block->codedLength))
+    {
+        return -1;
+    }
+
+    if (block->codedLength !=
+        fread(block->coded, 1, block->codedLength, fp))
+    {
+        if (!ferror(fp))
+        {
+            /* stream ended inside the block */
+            errno = EILSEQ;
+        }
+
+        return -1;
+    }
+
+    return 1;
+}
+
+/***************************************************************************
+*   Function   : WriteRawBlock
+*   Description: This routine writes the decoded bytes of a block.
+*   Parameters : fp - pointer to open file receiving decoded output
+*                block - pointer to decoded block
+*   Effects    : The block's raw bytes are written to fp.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int WriteRawBlock(FILE *fp, const block_t *block)
+{
+    if (block->rawLength != fwrite(block->raw, 1, block->rawLength, fp))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : WriteFramedBlock
+*   Description: This routine writes the header and encoded bytes of a
+*                block.
+*   Parameters : fp - pointer to open file receiving encoded output
+*                block - pointer to encoded block
+*   Effects    : The block is written to fp.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int WriteFramedBlock(FILE *fp, const block_t *block)
+{
+    unsigned char header[BLOCK_HEADER_SIZE];
+
+    header[0] = block->k;
+    header[1] = block->limit;
+    PutUint32(header + 2, (uint32_t)block->rawLength);
+    PutUint32(header + 6, (uint32_t)block->codedLength);
+
+    if ((BLOCK_HEADER_SIZE != fwrite(header, 1, BLOCK_HEADER_SIZE, fp)) ||
+        (block->codedLength !=
+        fwrite(block->coded, 1, block->codedLength, fp)))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : IndexAdd
+*   Description: This routine adds the index entry for a block that was
+*                just written.  The entry buffer doubles when it is full.
+*   Parameters : index - pointer to index being built
+*                block - pointer to the block that was written
+*   Effects    : An entry is appended to the index and the stream offset
+*                moves past the block.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int IndexAdd(block_index_t *index, const block_t *block)
+{
+    size_t used;
+
+    used = (size_t)index->count * INDEX_ENTRY_SIZE;
+
+    if (used == index->size)
+    {
+        if (0 != GrowBuffer(&index->entries, &index->size, (0 == used) ?
+            (INDEX_MIN_ENTRIES * INDEX_ENTRY_SIZE) : (2 * used)))
+        {
+            return -1;
+        }
+    }
+
+    PutUint64(index->entries + used, index->offset);
+    PutUint32(index->entries + used + 8, (uint32_t)block->rawLength);
+    index->count++;
+    index->offset += BLOCK_HEADER_SIZE + block->codedLength;
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : WriteIndex
+*   Description: This routine writes the index that ends a framed stream.
+*   Parameters : fp - pointer to open file receiving encoded output
+*                index - pointer to the index of every block written
+*   Effects    : The index is written to fp.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int WriteIndex(FILE *fp, const block_index_t *index)
+{
+    unsigned char trailer[INDEX_TRAILER_SIZE];
+    size_t used;
+
+    used = (size_t)index->count * INDEX_ENTRY_SIZE;
+    PutUint32(trailer, index->count);
+    memcpy(trailer + 4, INDEX_MAGIC, 4);
+
+    if ((EOF == fputc(INDEX_MARKER, fp)) ||
+        ((0 != used) && (used != fwrite(index->entries, 1, used, fp))) ||
+        (INDEX_TRAILER_SIZE != fwrite(trailer, 1, INDEX_TRAILER_SIZE, fp)))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : SkipIndex
+*   Description: This routine reads past the index of a stream that was
+*                decoded in order.  Only the trailer is checked, the block
+*                count must match the number of blocks decoded.
+*   Parameters : fp - pointer to open file being decoded, positioned after
+*                     the index marker
+*                count - number of blocks decoded
+*   Effects    : fp is positioned after the stream.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure (EILSEQ for a malformed index).
+***************************************************************************/
+static int SkipIndex(FILE *fp, const unsigned long count)
+{
+    unsigned char entry[INDEX_ENTRY_SIZE];
+    unsigned char trailer[INDEX_TRAILER_SIZE];
+    unsigned long i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (INDEX_ENTRY_SIZE != fread(entry, 1, INDEX_ENTRY_SIZE, fp))
+        {
+            break;
+        }
+    }
+
+    if ((i != count) ||
+        (INDEX_TRAILER_SIZE != fread(trailer, 1, INDEX_TRAILER_SIZE, fp)) ||
+        (GetUint32(trailer) != count) ||
+        (0 != memcmp(trailer + 4, INDEX_MAGIC, 4)))
+    {
+        if (!ferror(fp))
+        {
+            errno = EILSEQ;
+        }
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : DecodeIndexed
+*   Description: This routine decodes a framed stream using its index.
+*                Each worker thread takes the next block in the index,
+*                reads it with pread, decodes it, and writes it with pwrite
+*                at the output offset found by summing the raw lengths of
+*                the blocks before it.  Blocks are never copied to put them
+*                in order.  The stream must run to the end of inFile.
+*   Parameters : inFile - pointer to open file to decode
+*                outFile - pointer to open file receiving decoded output
+*                threads - number of worker threads
+*   Effects    : inFile is decoded to outFile and both are positioned
+*                after the data that was read and written.
+*   Returned   : 0 for success, -1 for failure, or 1 if the files can't be
+*                accessed by offset or the index isn't usable.  Nothing has
+*                been read or written when 1 is returned.  errno will be
+*                set in the event of a failure.
+***************************************************************************/
+static int DecodeIndexed(FILE *inFile, FILE *outFile,
+    const unsigned int threads)
+{
+    indexed_decode_t decode;
+    struct stat inStat, outStat;
+    pthread_t *workers;
+    unsigned int i, started;
+    int result, flags;
+
+    /* pwrite needs regular files and an output that isn't appended to */
+    if (0 != fflush(outFile))
+    {
+        return -1;
+    }
+
+    decode.inFd = fileno(inFile);
+    decode.outFd = fileno(outFile);
+    flags = fcntl(decode.outFd, F_GETFL);
+
+    if ((0 != fstat(decode.inFd, &inStat)) || !S_ISREG(inStat.st_mode) ||
+        (0 != fstat(decode.outFd, &outStat)) || !S_ISREG(outStat.st_mode) ||
+        (-1 == flags) || (flags & O_APPEND))
+    {
+        return 1;
+    }
+
+    decode.inStart = ftello(inFile);
+    decode.outStart = ftello(outFile);
+
+    if ((decode.inStart < 0) || (decode.outStart < 0) ||
+        (inStat.st_size < decode.inStart))
+    {
+        return 1;
+    }
+
+    result = ReadIndex(&decode, (uint64_t)(inStat.st_size - decode.inStart));
+
+    if (0 != result)
+    {
+        return result;
+    }
+
+    workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+
+    if (NULL == workers)
+    {
+        free(decode.offsets);
+        free(decode.outOffsets);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    decode.next = 0;
+    decode.error = 0;
+    pthread_mutex_init(&decode.lock, NULL);
+
+    for (started = 0; started < threads; started++)
+    {
+        result = pthread_create(&workers[started], NULL, IndexedWorker,
+            &decode);
+
+        if (0 != result)
+        {
+            /* the threads that did start will finish the work */
+            if (0 == started)
+            {
+                decode.error = result;
+            }
+
+            break;
+        }
+    }
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&decode.lock);
+    result = 0;
+
+    if (0 != decode.error)
+    {
+        errno = decode.error;
+        result = -1;
+    }
+    else
+    {
+        /* leave both files after the data, like the sequential decoder */
+        if ((0 != fseeko(inFile, inStat.st_size, SEEK_SET)) ||
+            (0 != fseeko(outFile, decode.outStart +
+            (off_t)decode.outOffsets[decode.count], SEEK_SET)))
+        {
+            result = -1;
+        }
+    }
+
+    free(workers);
+    free(decode.offsets);
+    free(decode.outOffsets);
+    return result;
+}
+
+/***************************************************************************
+*   Function   : ReadIndex
+*   Description: This routine reads and checks the index at the end of a
+*                framed stream.  The stream offset of every block and the
+*                output offset of its decoded bytes are stored.  One extra
+*                entry holds the stream offset of the index and the total
+*                decoded length, so each block's extent is the difference
+*                of two entries.
+*   Parameters : decode - pointer to indexed decode with the file offsets
+*                size - number of bytes from the start of the stream to
+*                       the end of the file
+*   Effects    : decode's offsets, outOffsets, and count are set.  They
+*                are allocated only when 0 is returned.
+*   Returned   : 0 for success, -1 for failure, or 1 if there isn't a usable
+*                index.  errno will be set in the event of a failure.
+***************************************************************************/
+static int ReadIndex(indexed_decode_t *decode, const uint64_t size)
+{
+    unsigned char trailer[INDEX_TRAILER_SIZE];
+    unsigned char *entries;
+    uint64_t indexStart, rawLength;
+    uint32_t i;
+    int result;
+
+    if (size < (1 + INDEX_TRAILER_SIZE))
+    {
+        return 1;
+    }
+
+    if (0 != ReadAt(decode->inFd, trailer, INDEX_TRAILER_SIZE,
+        decode->inStart + (off_t)(size - INDEX_TRAILER_SIZE)))
+    {
+        return (EILSEQ == errno) ? 1 : -1;
+    }
+
+    decode->count = GetUint32(trailer);
+
+    if ((0 != memcmp(trailer + 4, INDEX_MAGIC, 4)) ||
+        (((uint64_t)decode->count * INDEX_ENTRY_SIZE) >
+        (size - 1 - INDEX_TRAILER_SIZE)))
+    {
+        return 1;
+    }
+
+    indexStart = size - INDEX_TRAILER_SIZE - 1 -
+        ((uint64_t)decode->count * INDEX_ENTRY_SIZE);
+
+    entries = (unsigned char *)malloc(
+        ((size_t)decode->count * INDEX_ENTRY_SIZE) + 1);
+    decode->offsets = (uint64_t *)malloc(
+        ((size_t)decode->count + 1) * sizeof(uint64_t));
+    decode->outOffsets = (uint64_t *)malloc(
+        ((size_t)decode->count + 1) * sizeof(uint64_t));
+
+    if ((NULL == entries) || (NULL == decode->offsets) ||
+        (NULL == decode->outOffsets))
+    {
+        free(entries);
+        free(decode->offsets);
+        free(decode->outOffsets);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    /* the marker and every entry */
+    result = 0;
+
+    if (0 != ReadAt(decode->inFd, entries,
+        ((size_t)decode->count * INDEX_ENTRY_SIZE) + 1,
+        decode->inStart + (off_t)indexStart))
+    {
+        result = (EILSEQ == errno) ? 1 : -1;
+    }
+    else if (INDEX_MARKER != entries[0])
+    {
+        result = 1;
+    }
+
+    decode->outOffsets[0] = 0;
+
+    for (i = 0; (0 == result) && (i < decode->count); i++)
+    {
+        decode->offsets[i] = GetUint64(entries + 1 + (i * INDEX_ENTRY_SIZE));
+        rawLength = GetUint32(entries + 1 + (i * INDEX_ENTRY_SIZE) + 8);
+        decode->outOffsets[i + 1] = decode->outOffsets[i] + rawLength;
+
+        /* blocks must be in order, inside the stream, and not too long */
+        if ((rawLength > RICE_MAX_BLOCK_SIZE) ||
+            (indexStart < BLOCK_HEADER_SIZE) ||
+            (decode->offsets[i] > (indexStart - BLOCK_HEADER_SIZE)) ||
+            ((0 != i) && (decode->offsets[i] <
+            (decode->offsets[i - 1] + BLOCK_HEADER_SIZE))))
+        {
+            result = 1;
+        }
+    }
+
+    decode->offsets[decode->count] = indexStart;
+    free(entries);
+
+    if (0 != result)
+    {
+        free(decode->offsets);
+        free(decode->outOffsets);
+    }
+
+    return result;
+}
+
+/***************************************************************************
+*   Function   : IndexedWorker
+*   Description: This routine is the body of an indexed decode thread.  It
+*                decodes the next block in the index until every block has
+*                been taken or a thread fails.
+*   Parameters : arg - pointer to the indexed decode
+*   Effects    : Blocks are decoded to the output file.
+*   Returned   : NULL
+***************************************************************************/
+static void *IndexedWorker(void *arg)
+{
+    indexed_decode_t *decode;
+    block_t block;
+    uint32_t i;
+
+    decode = (indexed_decode_t *)arg;
+    memset(&block, 0, sizeof(block));
+
+    while (1)
+    {
+        pthread_mutex_lock(&decode->lock);
+
+        if ((0 != decode->error) || (decode->next == decode->count))
+        {
+            pthread_mutex_unlock(&decode->lock);
+            break;
+        }
+
+        i = decode->next;
+        decode->next++;
+        pthread_mutex_unlock(&decode->lock);
+
+        if (0 != DecodeIndexedBlock(decode, &block, i))
+        {
+            pthread_mutex_lock(&decode->lock);
+
+            if (0 == decode->error)
+            {
+                decode->error = errno;
+            }
+
+            pthread_mutex_unlock(&decode->lock);
+            break;
+        }
+    }
+
+    free(block.raw);
+    free(block.coded);
+    return NULL;
+}
+
+/***************************************************************************
+*   Function   : DecodeIndexedBlock
+*   Description: This routine reads, decodes, and writes a single block
+*                found through the index.  The block's header must agree
+*                with the index.
+*   Parameters : decode - pointer to indexed decode
+*                block - pointer to the calling thread's block buffers
+*                i - number of the block to decode
+*   Effects    : Block i is decoded to its place in the output file.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure (EILSEQ for a malformed block).
+***************************************************************************/
+static int DecodeIndexedBlock(indexed_decode_t *decode, block_t *block,
+    const uint32_t i)
+{
+    unsigned char header[BLOCK_HEADER_SIZE];
+    uint64_t extent;
+
+    if (0 != ReadAt(decode->inFd, header, BLOCK_HEADER_SIZE,
+        decode->inStart + (off_t)decode->offsets[i]))
+    {
+        return -1;
+    }
+
+    block->k = header[0];
+    block->limit = header[1];
+    block->rawLength = GetUint32(header + 2);
+    block->codedLength = GetUint32(header + 6);
+    extent = decode->offsets[i + 1] - decode->offsets[i];
+
+    if (!VALID_K(block->k) ||
+        (block->rawLength != (decode->outOffsets[i + 1] -
+        decode->outOffsets[i])) ||
+        (block->codedLength >
+        EncodeBound(block->rawLength, block->k, block->limit)) ||
+        ((BLOCK_HEADER_SIZE + (uint64_t)block->codedLength) > extent))
+    {
+        errno = EILSEQ;
+        return -1;
+    }
+
+    if ((0 != GrowBuffer(&block->coded, &block->codedSize,
+        block->codedLength)) ||
+        (0 != ReadAt(decode->inFd, block->coded, block->codedLength,
+        decode->inStart + (off_t)(decode->offsets[i] + BLOCK_HEADER_SIZE))) ||
+        (0 != DecodeBlock(block)))
+    {
+        return -1;
+    }
+
+    return WriteAt(decode->outFd, block->raw, block->rawLength,
+        decode->outStart + (off_t)decode->outOffsets[i]);
+}
+
+/***************************************************************************
+*   Function   : ReadAt
+*   Description: This routine reads count bytes from an offset in a file
+*                without moving the file's position, retrying short reads.
+*   Parameters : fd - file descriptor to read
+*                buffer - pointer to memory receiving the bytes
+*                count - number of bytes to read
+*                offset - file offset of the first byte
+*   Effects    : buffer is filled.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure (EILSEQ if the file ends first).
+***************************************************************************/
+static int ReadAt(const int fd, unsigned char *buffer, const size_t count,
+    const off_t offset)
+{
+    size_t done;
+    ssize_t result;
+
+    for (done = 0; done < count; done += result)
+    {
+        result = pread(fd, buffer + done, count - done,
+            offset + (off_t)done);
+
+        if (result < 0)
+        {
+            if (EINTR == errno)
+            {
+                result = 0;
+                continue;
+            }
+
+            return -1;
+        }
+
+        if (0 == result)
+        {
+            errno = EILSEQ;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : WriteAt
+*   Description: This routine writes count bytes to an offset in a file
+*                without moving the file's position, retrying short writes.
+*   Parameters : fd - file descriptor to write
+*                buffer - pointer to the bytes to write
+*                count - number of bytes to write
+*                offset - file offset of the first byte
+*   Effects    : The bytes are written to the file.
+*   Returned   : 0 for success, -1 for failure.  errno will be set in the
+*                event of a failure.
+***************************************************************************/
+static int WriteAt(const int fd, const unsigned char *buffer,
+    const size_t count, const off_t offset)
+{
+    size_t done;
+    ssize_t result;
+
+    for (done = 0; done < count; done += result)
+    {
+        result = pwrite(fd, buffer + done, count - done,
+            offset + (off_t)done);
+
+        if (result < 0)
+        {
+            if (EINTR == errno)
+            {
+                result = 0;
+                continue;
+            }
+
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : PutUint32
+*   Description: This routine stores a 32 bit value as 4 big endian bytes.
+*   Parameters : bytes - pointer to 4 bytes
+*                value - value to store
+*   Effects    : bytes is written.
+*   Returned   : None
+***************************************************************************/
+static void PutUint32(unsigned char *bytes, const uint32_t value)
+{
+    bytes[0] = (unsigned char)(value >> 24);
+    bytes[1] = (unsigned char)(value >> 16);
+    bytes[2] = (unsigned char)(value >> 8);
+    bytes[3] = (unsigned char)value;
+}
+
+/***************************************************************************
+*   Function   : GetUint32
+*   Description: This routine loads a 32 bit value from 4 big endian bytes.
+*   Parameters : bytes - pointer to 4 bytes
+*   Effects    : None
+*   Returned   : The value stored in bytes.
+***************************************************************************/
+static uint32_t GetUint32(const unsigned char *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) |
+        ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+/***************************************************************************
+*   Function   : PutUint64
+*   Description: This routine stores a 64 bit value as 8 big endian bytes.
+*   Parameters : bytes - pointer to 8 bytes
+*                value - value to store
+*   Effects    : bytes is written.
+*   Returned   : None
+***************************************************************************/
+static void PutUint64(unsigned char *bytes, const uint64_t value)
+{
+    PutUint32(bytes, (uint32_t)(value >> 32));
+    PutUint32(bytes + 4, (uint32_t)value);
+}
+
+/***************************************************************************
+*   Function   : GetUint64
+*   Description: This routine loads a 64 bit value from 8 big endian bytes.
+*   Parameters : bytes - pointer to 8 bytes
+*   Effects    : None
+*   Returned   : The value stored in bytes.
+***************************************************************************/
+static uint64_t GetUint64(const unsigned char *bytes)
+{
+    return ((uint64_t)GetUint32(bytes) << 32) | GetUint32(bytes + 4);
+}
@@ -0,0 +1,367 @@
+/***************************************************************************
+*                 Rice Encoding SIMD Accelerated Kernels
+*
+*   File    : ricesimd.c
+*   Purpose : Provide instruction set specific kernels for Rice encoding
+*             and decoding.  Each kernel is compiled for its instruction
+*             set with a target attribute, so the library runs on any CPU
+*             and only uses a kernel after checking the CPU supports it.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Rice: ANSI C Rice Encoding/Decoding Routines
+* Copyright (C) 2008 - 2015, 2026 by
+* Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the rice library.
+*
+* The rice library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The rice library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <string.h>
+#include "ricesimd.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define RICE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+#define WORD_BITS       64
+
+/* 64 bit words needed to assemble the output of RiceEncodeAvx2 */
+#define AVX2_WORDS      (AVX2_OUT_BYTES / 8)
+
+/***************************************************************************
+*                                FUNCTIONS
+***************************************************************************/
+
+#if defined(RICE_X86_KERNELS)
+
+/***************************************************************************
+*   Function   : RiceHaveAvx2
+*   Description: This routine checks if the CPU supports AVX2.
+*   Parameters : None
+*   Effects    : None
+*   Returned   : Non-zero if the AVX2 kernels may be used, otherwise 0.
+***************************************************************************/
+int RiceHaveAvx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+/***************************************************************************
+*   Function   : RiceEncodeAvx2
+*   Description: This routine Rice encodes AVX2_SYMBOLS symbols with a k
+*                bit binary portion.  Codewords and their lengths are
+*                computed 8 at a time in 32 bit vector lanes.  A prefix sum
+*                of the lengths gives each codeword's bit offset, adjacent
+*                codewords are merged into 64 bit lanes, and the merged
+*                codewords are ORed into the output 64 bits at a time.
+*   Parameters : symbols - AVX2_SYMBOLS symbols to encode
+*                k - length of binary portion of encoded word
+*                maxLength - longest codeword to encode (at most
+*                            AVX2_MAX_CODEWORD), longer codewords are left
+*                            to the caller
+*                bits - pointer to bits that haven't been written yet
+*                       (right justified).  On return it holds the bits
+*                       that didn't make a whole byte.
+*                count - pointer to the number of bits in bits (< 8)
+*                out - pointer to at least AVX2_OUT_BYTES bytes receiving
+*                      the encoded output
+*   Effects    : The codewords for symbols are written to out.  Bytes past
+*                the returned count may be overwritten.
+*   Returned   : The number of whole bytes written to out, or AVX2_TOO_LONG
+*                if a codeword is longer than maxLength bits.
+*                Nothing is written and bits are unchanged if
+*                AVX2_TOO_LONG is returned.
+***************************************************************************/
+__attribute__((target("avx2")))
+size_t RiceEncodeAvx2(const unsigned char *symbols, const unsigned char k,
+    const unsigned int maxLength, uint64_t *bits, unsigned int *count,
+    unsigned char *out)
+{
+    uint64_t words[AVX2_WORDS];
+    uint64_t codes[AVX2_SYMBOLS / 2];       /* merged codeword pairs */
+    uint64_t lengths[AVX2_SYMBOLS / 2];     /* lengths of merged pairs */
+    uint32_t offsets[AVX2_SYMBOLS];         /* bit offset of each codeword */
+    __m256i c, unary, length, code, scan, carry, merged;
+    __m256i binaryShift, binaryMask, extraBits, tooLong, base;
+    __m256i ones, low32, highHalf, lane3;
+    unsigned int total, offset, shift, i;
+    uint64_t left;
+
+    ones = _mm256_set1_epi32(-1);
+    low32 = _mm256_set1_epi64x(0xFFFFFFFF);
+    highHalf = _mm256_set_epi32(-1, -1, -1, -1, 0, 0, 0, 0);
+    lane3 = _mm256_set1_epi32(3);
+    binaryShift = _mm256_set1_epi32(k + 1);
+    binaryMask = _mm256_set1_epi32((1 << k) - 1);
+    extraBits = _mm256_set1_epi32(k + 1);
+    tooLong = _mm256_setzero_si256();
+    base = _mm256_set1_epi32(*count);
+
+    for (i = 0; i < AVX2_SYMBOLS; i += 8)
+    {
+        /* 8 symbols in 32 bit lanes */
+        c = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64((const __m128i *)(symbols + i)));
+
+        /* codeword length is (c >> k) + 1 + k */
+        unary = _mm256_srl_epi32(c, _mm_cvtsi32_si128(k));
+        length = _mm256_add_epi32(unary, extraBits);
+        tooLong = _mm256_or_si256(tooLong,
+            _mm256_cmpgt_epi32(length, _mm256_set1_epi32(maxLength)));
+
+        /* unary 1s (shifts of 32 give 0), an ending 0, then the binary */
+        code = _mm256_srlv_epi32(ones,
+            _mm256_sub_epi32(_mm256_set1_epi32(32), unary));
+        code = _mm256_sllv_epi32(code, binaryShift);
+        code = _mm256_or_si256(code, _mm256_and_si256(c, binaryMask));
+
+        /* inclusive prefix sum of the lengths */
+        scan = _mm256_add_epi32(length, _mm256_slli_si256(length, 4));
+        scan = _mm256_add_epi32(scan, _mm256_slli_si256(scan, 8));
+        carry = _mm256_and_si256(_mm256_permutevar8x32_epi32(scan, lane3),
+            highHalf);
+        scan = _mm256_add_epi32(scan, carry);
+
+        /* exclusive prefix sum is the offset of each codeword */
+        _mm256_storeu_si256((__m256i *)(offsets + i),
+            _mm256_add_epi32(_mm256_sub_epi32(scan, length), base));
+        base = _mm256_add_epi32(base,
+            _mm256_permutevar8x32_epi32(scan, _mm256_set1_epi32(7)));
+
+        /* merge each even codeword with the odd codeword that follows */
+        merged = _mm256_sllv_epi64(_mm256_and_si256(code, low32),
+            _mm256_srli_epi64(length, 32));
+        merged = _mm256_or_si256(merged, _mm256_srli_epi64(code, 32));
+        _mm256_storeu_si256((__m256i *)(codes + (i / 2)), merged);
+        _mm256_storeu_si256((__m256i *)(lengths + (i / 2)),
+            _mm256_add_epi64(_mm256_and_si256(length, low32),
+            _mm256_srli_epi64(length, 32)));
+    }
+
+    if (!_mm256_testz_si256(tooLong, tooLong))
+    {
+        return AVX2_TOO_LONG;
+    }
+
+    total = (unsigned int)_mm256_extract_epi32(base, 0);
+    memset(words, 0, sizeof(words));
+
+    /* start with the bits that haven't been written */
+    if (*count != 0)
+    {
+        words[0] = *bits << (WORD_BITS - *count);
+    }
+
+    /* OR the left justified codeword pairs into place */
+    for (i = 0; i < (AVX2_SYMBOLS / 2); i++)
+    {
+        offset = offsets[2 * i];
+        shift = offset % WORD_BITS;
+        left = codes[i] << (WORD_BITS - lengths[i]);
+        words[offset / WORD_BITS] |= left >> shift;
+        words[(offset / WORD_BITS) + 1] |= (left << 1) << (WORD_BITS - 1 - shift);
+    }
+
+    /* write the words most significant byte first */
+    for (i = 0; i < ((total + WORD_BITS - 1) / WORD_BITS); i++)
+    {
+        words[i] = __builtin_bswap64(words[i]);
+        memcpy(out + (8 * i), &words[i], 8);
+    }
+
+    /* keep the bits that don't make a whole byte */
+    *count = total % 8;
+    *bits = (*count != 0) ? (out[total / 8] >> (8 - *count)) : 0;
+
+    return total / 8;
+}
+
+/***************************************************************************
+*   Function   : RiceHaveBmi2
+*   Description: This routine checks if the CPU supports BMI2 and LZCNT.
+*   Parameters : None
+*   Effects    : None
+*   Returned   : Non-zero if the BMI2 kernels may be used, otherwise 0.
+***************************************************************************/
+int RiceHaveBmi2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("lzcnt");
+}
+
+/***************************************************************************
+*   Function   : RiceDecodeBmi2
+*   Description: This routine decodes every complete codeword in a 64 bit
+*                window of Rice encoded bits with a k bit binary portion.
+*                The stream is msb first, so LZCNT of the inverted window
+*                finds the ending 0 of each unary run.  The positions of
+*                the binary portions are collected in a mask and PEXT
+*                extracts all of them at once.
+*   Parameters : window - encoded bits, msb first
+*                count - number of valid bits in window (bits past count
+*                        must be 0)
+*                k - length of binary portion of encoded word (1 - 7)
+*                maxUnary - longest unary portion to decode, decoding stops
+*                           at a longer one
+*                symbols - pointer to at least BMI2_SYMBOLS bytes receiving
+*                          the decoded symbols
+*                used - pointer to where the number of bits used by the
+*                       decoded symbols is stored
+*   Effects    : Decoded symbols are written to symbols.
+*   Returned   : The number of symbols decoded.  0 means the window starts
+*                with a codeword that doesn't fit in it or has a unary
+*                portion longer than maxUnary.
+***************************************************************************/
+__attribute__((target("bmi2,lzcnt")))
+unsigned int RiceDecodeBmi2(const uint64_t window, const unsigned int count,
+    const unsigned char k, const unsigned int maxUnary,
+    unsigned char *symbols, unsigned int *used)
+{
+    uint64_t binaryMask, positions, binary;
+    unsigned int pos, unary, end, n, i;
+
+    binaryMask = ((uint64_t)1 << k) - 1;
+    positions = 0;
+    pos = 0;
+    n = 0;
+
+    /* find the end of each codeword, LZCNT of 0 is 64 */
+    while (pos < count)
+    {
+        unary = (unsigned int)_lzcnt_u64(~(window << pos));
+        end = pos + unary + 1 + k;
+
+        if ((end > count) || (unary > maxUnary))
+        {
+            break;
+        }
+
+        /* symbols holds the unary portion until the binary is extracted */
+        symbols[n] = (unsigned char)unary;
+        positions |= binaryMask << (WORD_BITS - end);
+        n++;
+        pos = end;
+    }
+
+    /* the binary portions packed together, last symbol in the lsbs */
+    binary = _pext_u64(window, positions);
+
+    for (i = 0; i < n; i++)
+    {
+        symbols[i] = (unsigned char)((symbols[i] << k) |
+            ((binary >> ((n - 1 - i) * k)) & binaryMask));
+    }
+
+    *used = pos;
+    return n;
+}
+
+#else   /* no x86 kernels */
+
+/***************************************************************************
+*   Function   : RiceHaveAvx2
+*   Description: This routine reports that AVX2 kernels aren't built for
+*                this compiler or architecture.
+*   Parameters : None
+*   Effects    : None
+*   Returned   : 0
+***************************************************************************/
+int RiceHaveAvx2(void)
+{
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : RiceEncodeAvx2
+*   Description: This routine is a place holder for compilers and
+*                architectures without AVX2 kernels.  It is never called
+*                because RiceHaveAvx2 returns 0.
+*   Parameters : symbols - not used
+*                k - not used
+*                maxLength - not used
+*                bits - not used
+*                count - not used
+*                out - not used
+*   Effects    : None
+*   Returned   : AVX2_TOO_LONG
+***************************************************************************/
+size_t RiceEncodeAvx2(const unsigned char *symbols, const unsigned char k,
+    const unsigned int maxLength, uint64_t *bits, unsigned int *count,
+    unsigned char *out)
+{
+    (void)symbols;
+    (void)k;
+    (void)maxLength;
+    (void)bits;
+    (void)count;
+    (void)out;
+
+    return AVX2_TOO_LONG;
+}
+
+/***************************************************************************
+*   Function   : RiceHaveBmi2
+*   Description: This routine reports that BMI2 kernels aren't built for
+*                this compiler or architecture.
+*   Parameters : None
+*   Effects    : None
+*   Returned   : 0
+***************************************************************************/
+int RiceHaveBmi2(void)
+{
+    return 0;
+}
+
+/***************************************************************************
+*   Function   : RiceDecodeBmi2
+*   Description: This routine is a place holder for compilers and
+*                architectures without BMI2 kernels.  It is never called
+*                because RiceHaveBmi2 returns 0.
+*   Parameters : window - not used
+*                count - not used
+*                k - not used
+*                maxUnary - not used
+*                symbols - not used
+*                used - pointer to where 0 is stored
+*   Effects    : None
+*   Returned   : 0
+***************************************************************************/
+unsigned int RiceDecodeBmi2(const uint64_t window, const unsigned int count,
+    const unsigned char k, const unsigned int maxUnary,
+    unsigned char *symbols, unsigned int *used)
+{
+    (void)window;
+    (void)count;
+    (void)k;
+    (void)maxUnary;
+    (void)symbols;
+
+    *used = 0;
+    return 0;
+}
+
+#endif  /* RICE_X86_KERNELS */
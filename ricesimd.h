@@ -0,0 +1,83 @@
+/***************************************************************************
+*              Header for Rice Encoding SIMD Accelerated Kernels
+*
+*   File    : ricesimd.h
+*   Purpose : Provides prototypes for the instruction set specific kernels
+*             used by the rice library.  These functions are internal to
+*             the library.
+*   Author  : Michael Dipperstein
+*   Date    : October 18, 2026
+*
+****************************************************************************
+*
+* Rice: ANSI C Rice Encoding/Decoding Routines
+* Copyright (C) 2008 - 2015, 2026 by
+* Michael Dipperstein (mdipperstein@gmail.com)
+*
+* This file is part of the rice library.
+*
+* The rice library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License as
+* published by the Free Software Foundation; either version 3 of the
+* License, or (at your option) any later version.
+*
+* The rice library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+***************************************************************************/
+
+#ifndef _RICESIMD_H_
+#define _RICESIMD_H_
+
+/***************************************************************************
+*                             INCLUDED FILES
+***************************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/***************************************************************************
+*                                CONSTANTS
+***************************************************************************/
+/* symbols encoded by each call to RiceEncodeAvx2 */
+#define AVX2_SYMBOLS        32
+
+/* longest codeword RiceEncodeAvx2 handles */
+#define AVX2_MAX_CODEWORD   32
+
+/* output space RiceEncodeAvx2 needs (it may write past the bytes it keeps) */
+#define AVX2_OUT_BYTES      144
+
+/* returned by RiceEncodeAvx2 for symbols with codewords that are too long */
+#define AVX2_TOO_LONG       ((size_t)-1)
+
+/* most symbols RiceDecodeBmi2 decodes from a window (k = 1) */
+#define BMI2_SYMBOLS        32
+
+/* smallest k for which RiceDecodeBmi2 beats the table decoder */
+#define BMI2_MIN_K          6
+
+/***************************************************************************
+*                               PROTOTYPES
+***************************************************************************/
+/* non-zero if the CPU and library support the AVX2 kernels */
+int RiceHaveAvx2(void);
+
+/* encode AVX2_SYMBOLS symbols, returns whole bytes written to out */
+size_t RiceEncodeAvx2(const unsigned char *symbols, const unsigned char k,
+    const unsigned int maxLength, uint64_t *bits, unsigned int *count,
+    unsigned char *out);
+
+/* non-zero if the CPU and library support the BMI2 kernels */
+int RiceHaveBmi2(void);
+
+/* decode every codeword in a window, returns number of symbols decoded */
+unsigned int RiceDecodeBmi2(const uint64_t window, const unsigned int count,
+    const unsigned char k, const unsigned int maxUnary,
+    unsigned char *symbols, unsigned int *used);
+
+#endif  /* ndef _RICESIMD_H_ */
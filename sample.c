@@ -36,6 +36,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include "optlist/optlist.h"
 #include "rice.h"
 
@@ -65,17 +66,35 @@ int main(int argc, char *argv[])
     FILE *outFile;
     char encode;                    /* encode/decode */
     unsigned char k;
+    char autoK;                     /* best k for each block */
+    char framed;                    /* framed stream/unframed stream */
+    int threads;                    /* framed stream threads */
+    int limit;                      /* unary length of an escape */
+    int width;                      /* bits per sample */
+    int predictor;                  /* predictor order, -1 for unsigned */
+    char samples;                   /* samples/bytes */
+    unsigned char order;            /* byte order of samples */
+    char header;                    /* self-describing sample stream */
+    rice_options_t options;
     option_t *optList;
     option_t *thisOpt;
 
     /* initialize variables */
     k = 0;
+    autoK = 0;
+    framed = 0;
+    threads = 1;
+    limit = 0;
+    width = 8;
+    predictor = -1;
+    order = RICE_BIG_ENDIAN;
+    header = 0;
     encode = 1;
     inFile = NULL;
     outFile = NULL;
 
     /* parse command line */
-    optList = GetOptList(argc, argv, "cdk:i:o:h?");
+    optList = GetOptList(argc, argv, "cdk:t:l:w:e:p:si:o:h?");
     thisOpt = optList;
 
     while (thisOpt != NULL)
@@ -91,7 +110,63 @@ int main(int argc, char *argv[])
                 break;
 
             case 'k':       /* length of binary portion */
-                k = (unsigned char)atoi(thisOpt->argument);
+                if (strcmp(thisOpt->argument, "auto") == 0)
+                {
+                    /* best k for each block of a framed stream */
+                    k = RICE_AUTO_K;
+                    autoK = 1;
+                    framed = 1;
+                }
+                else if (strcmp(thisOpt->argument, "adaptive") == 0)
+                {
+                    /* k follows the symbols (JPEG-LS style) */
+                    k = RICE_ADAPTIVE_K;
+                    autoK = 0;
+                }
+                else
+                {
+                    k = (unsigned char)atoi(thisOpt->argument);
+                    autoK = 0;
+
+                    if ((k == RICE_AUTO_K) &&
+                        (strcmp(thisOpt->argument, "0") != 0))
+                    {
+                        /* don't mistake a bad k for 0 */
+                        k = UCHAR_MAX;
+                    }
+                }
+                break;
+
+            case 't':       /* framed stream coded by threads */
+                threads = atoi(thisOpt->argument);
+                framed = 1;
+                break;
+
+            case 'l':       /* escapes */
+                limit = atoi(thisOpt->argument);
+                break;
+
+            case 'w':       /* sample width */
+                width = atoi(thisOpt->argument);
+                break;
+
+            case 'p':       /* signed samples with a fixed predictor */
+                predictor = atoi(thisOpt->argument);
+                break;
+
+            case 'e':       /* sample byte order */
+                if (strcmp(thisOpt->argument, "little") == 0)
+                {
+                    order = RICE_LITTLE_ENDIAN;
+                }
+                else
+                {
+                    order = RICE_BIG_ENDIAN;
+                }
+                break;
+
+            case 's':       /* sample stream with a header */
+                header = 1;
                 break;
 
             case 'i':       /* input file name */
@@ -162,10 +237,52 @@ int main(int argc, char *argv[])
         thisOpt = optList;
     }
 
-    /* validate command line */
-    if (k < 1 || k > 7)
+    samples = (width != 8) || (predictor != -1) || header;
+
+    if (header && !encode)
+    {
+        /* the header has everything needed for decoding */
+        k = 0;
+        limit = 0;
+        width = 8;
+        predictor = -1;
+    }
+
+    if (!samples && (limit != 0))
+    {
+        /* byte streams only store their limit when they're framed */
+        framed = 1;
+    }
+
+    /* validate command line, framed streams carry k for decoding */
+    if (samples && (framed || ((width != 8) && (width != 16) &&
+        (width != 24) && (width != 32)) || (predictor < -1) ||
+        (predictor > 3) || ((k > 31) && !((k == RICE_ADAPTIVE_K) &&
+        (width == 8) && (predictor == -1)))))
+    {
+        fprintf(stderr, "Error: width must be 8, 16, 24, or 32 with a k of "
+            "0 to 31 and a predictor order of 0 to 3.\n");
+        ShowUsage(argv[0]);
+
+        if (inFile != NULL)
+        {
+            fclose(inFile);
+        }
+
+        if (outFile != NULL)
+        {
+            fclose(outFile);
+        }
+
+        FreeOptList(optList);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!samples && (encode || !framed) && !autoK &&
+        (k < 1 || k > 7) && (k != RICE_ADAPTIVE_K))
     {
-        fprintf(stderr, "Error: k must be between 1 and 7.\n");
+        fprintf(stderr,
+            "Error: k must be between 1 and 7, auto, or adaptive.\n");
         ShowUsage(argv[0]);
 
         if (inFile != NULL)
@@ -182,6 +299,44 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    if ((threads < 1) || (threads > RICE_MAX_THREADS))
+    {
+        fprintf(stderr, "Error: threads must be between 1 and %d.\n",
+            RICE_MAX_THREADS);
+        ShowUsage(argv[0]);
+
+        if (inFile != NULL)
+        {
+            fclose(inFile);
+        }
+
+        if (outFile != NULL)
+        {
+            fclose(outFile);
+        }
+
+        exit(EXIT_FAILURE);
+    }
+
+    if ((limit < 0) || (limit > RICE_MAX_LIMIT))
+    {
+        fprintf(stderr, "Error: limit must be between 0 and %d.\n",
+            RICE_MAX_LIMIT);
+        ShowUsage(argv[0]);
+
+        if (inFile != NULL)
+        {
+            fclose(inFile);
+        }
+
+        if (outFile != NULL)
+        {
+            fclose(outFile);
+        }
+
+        exit(EXIT_FAILURE);
+    }
+
     if (inFile == NULL)
     {
         fprintf(stderr, "Input file must be provided\n");
@@ -208,7 +363,43 @@ int main(int argc, char *argv[])
     }
 
     /* we have valid parameters encode or decode */
-    if (encode)
+    if (samples)
+    {
+        memset(&options, 0, sizeof(options));
+        options.k = k;
+        options.limit = limit;
+        options.width = (unsigned char)width;
+        options.order = order;
+        options.predictor = (predictor < 0) ? RICE_UNSIGNED :
+            (unsigned char)(RICE_PREDICT_0 + predictor);
+        options.flags = header ? RICE_FLAG_HEADER : 0;
+
+        if (encode)
+        {
+            RiceEncodeSamples(inFile, outFile, &options);
+        }
+        else
+        {
+            RiceDecodeSamples(inFile, outFile, &options);
+        }
+    }
+    else if (framed)
+    {
+        memset(&options, 0, sizeof(options));
+        options.k = k;
+        options.threads = threads;
+        options.limit = limit;
+
+        if (encode)
+        {
+            RiceEncodeFileEx(inFile, outFile, &options);
+        }
+        else
+        {
+            RiceDecodeFileEx(inFile, outFile, &options);
+        }
+    }
+    else if (encode)
     {
         RiceEncodeFile(inFile, outFile, k);
     }
@@ -237,7 +428,13 @@ void ShowUsage(const char *progName)
     printf("Options:\n");
     printf("  -c : Encode input file to output file.\n");
     printf("  -d : Decode input file to output file.\n");
-    printf("  -k [1-7]: Length of binary portion.\n");
+    printf("  -k [1-7|auto|adaptive]: Length of binary portion.\n");
+    printf("  -t <threads> : Code framed blocks using threads.\n");
+    printf("  -l <limit> : Escape unary portions of limit bits.\n");
+    printf("  -w [8|16|24|32] : Bits per sample (k may be 0 - 31).\n");
+    printf("  -e [big|little] : Byte order of samples.\n");
+    printf("  -p [0-3] : Code signed samples with a fixed predictor.\n");
+    printf("  -s : Sample stream header (decode needs no other options).\n");
     printf("  -i <filename> : Name of input file.\n");
     printf("  -o <filename> : Name of output file.\n");
     printf("  -h | ?  : Print out command line options.\n\n");
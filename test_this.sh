@@ -30,7 +30,14 @@ do
         ./sample -k5 -d -i foo -o bar
         diff $X bar
         filesize=$(stat -c '%s' foo)
-        printf "compressed with -k5 size:\t%d\n\n" $filesize
+        printf "compressed with -k5 size:\t%d\n" $filesize
+        rm foo
+        rm bar
+        ./sample -k auto -c -i $X -o foo
+        ./sample -k auto -d -i foo -o bar
+        diff $X bar
+        filesize=$(stat -c '%s' foo)
+        printf "compressed with -k auto size:\t%d\n\n" $filesize
         rm foo
         rm bar
     fi